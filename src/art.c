@@ -0,0 +1,681 @@
+#include "art.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contains the implementation for an adaptive radix tree(ART) that counts byte
+ * string keys the way the GT counts values. The key of each value comes from a
+ * callback, so the tree works on any value that can expose its bytes. Inner nodes
+ * branch on one key byte and come in four sizes, holding up to 4, 16, 48 or 256
+ * children; a node is replaced by the next size when it fills up and by the
+ * previous one when enough children are removed. A chain of nodes with one child
+ * each is compressed into a prefix stored in the node below it, so the depth of
+ * a search is bounded by the key length and not the number of keys, and values
+ * sharing long prefixes share the nodes for them.
+ *
+ * Only the first MAX_PREFIX bytes of a prefix are kept in the node. Searches skip
+ * over the rest and compare the full key once they reach a leaf, while inserts
+ * read the missing bytes from any leaf below the node. A key that ends at an inner
+ * node, because it is a prefix of other keys, is kept in that node's end slot.
+ */
+
+#define TYPE4 0
+#define TYPE16 1
+#define TYPE48 2
+#define TYPE256 3
+#define TYPELEAF 4
+#define MAX_PREFIX 8
+
+#define TYPE(p) (*(unsigned char *) (p))
+
+#ifdef __GNUC__
+#define LOWEST(mask) __builtin_ctz(mask)
+#else
+static int LOWEST(unsigned mask) {
+	int i = 0;
+	while(!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+}
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef struct artleaf {
+	unsigned char type;
+	int freq;
+	void *value;
+} LEAF;
+
+typedef struct artnode {
+	unsigned char type;
+	short count;            //number of children
+	int prefixLength;       //may be longer than the bytes kept in prefix
+	unsigned char prefix[MAX_PREFIX];
+	LEAF *end;              //the value whose key ends at this node, if any
+} NODE;
+
+//Children are either nodes or leaves, told apart by their first byte
+typedef struct artnode4 {
+	NODE n;
+	unsigned char keys[4];  //sorted
+	void *children[4];
+} NODE4;
+
+typedef struct artnode16 {
+	NODE n;
+	unsigned char keys[16]; //sorted
+	void *children[16];
+} NODE16;
+
+typedef struct artnode48 {
+	NODE n;
+	unsigned char index[256];   //slot+1 of the child for each byte, 0 for none
+	void *children[48];
+} NODE48;
+
+typedef struct artnode256 {
+	NODE n;
+	void *children[256];
+} NODE256;
+
+struct art {
+	void *root;
+	int size, words;
+	void (*display)(FILE *, void *);
+	const unsigned char *(*key)(void *, int *);
+};
+
+static const size_t nodeSize[] = { sizeof(NODE4), sizeof(NODE16), sizeof(NODE48), sizeof(NODE256) };
+
+ART *newART(void (*d)(FILE *, void *), const unsigned char *(*k)(void *, int *)) {
+	ART *t = malloc(sizeof(ART));
+	assert(t != 0);
+
+	t->root = NULL;
+	t->size = 0;
+	t->words = 0;
+	t->display = d;
+	t->key = k;
+	return t;
+}
+
+static LEAF *newLEAF(void *value) {
+	LEAF *l = malloc(sizeof(LEAF));
+	assert(l != 0);
+	l->type = TYPELEAF;
+	l->freq = 1;
+	l->value = value;
+	return l;
+}
+static NODE *newNODE(int type) {
+	NODE *n = calloc(1, nodeSize[type]);
+	assert(n != 0);
+	n->type = type;
+	return n;
+}
+static void setPrefix(NODE *n, const unsigned char *bytes, int length) {
+	n->prefixLength = length;
+	memcpy(n->prefix, bytes, length < MAX_PREFIX ? length : MAX_PREFIX);
+}
+static int leafMatches(ART *t, LEAF *l, const unsigned char *key, int length) {
+	int leafLength;
+	const unsigned char *leafKey = t->key(l->value, &leafLength);
+	return leafLength == length && memcmp(leafKey, key, length) == 0;
+}
+/*
+ * Returns the sorted key bytes and children of a NODE4 or NODE16.
+ */
+static unsigned char *keysOf(NODE *n) {
+	return n->type == TYPE4 ? ((NODE4 *) n)->keys : ((NODE16 *) n)->keys;
+}
+static void **childrenOf(NODE *n) {
+	return n->type == TYPE4 ? ((NODE4 *) n)->children : ((NODE16 *) n)->children;
+}
+
+/*
+ * Returns the address of the child for the byte, or NULL if there is none.
+ */
+static void **findChild(NODE *n, unsigned char byte) {
+	switch(n->type) {
+		case TYPE4: {
+			NODE4 *m = (NODE4 *) n;
+			for(int i=0; i<n->count; i++)
+				if(m->keys[i] == byte)
+					return &m->children[i];
+			return NULL;
+		}
+		case TYPE16: {
+			NODE16 *m = (NODE16 *) n;
+#ifdef __SSE2__
+			__m128i keys = _mm_loadu_si128((__m128i *) m->keys);
+			unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8(byte)));
+			mask &= (1u << n->count) - 1;
+			return mask == 0 ? NULL : &m->children[LOWEST(mask)];
+#else
+			for(int i=0; i<n->count; i++)
+				if(m->keys[i] == byte)
+					return &m->children[i];
+			return NULL;
+#endif
+		}
+		case TYPE48: {
+			NODE48 *m = (NODE48 *) n;
+			return m->index[byte] == 0 ? NULL : &m->children[m->index[byte]-1];
+		}
+		default: {
+			NODE256 *m = (NODE256 *) n;
+			return m->children[byte] == NULL ? NULL : &m->children[byte];
+		}
+	}
+}
+/*
+ * Adds a child to a node that has room for it.
+ */
+static void insertChild(NODE *n, unsigned char byte, void *child) {
+	if(n->type == TYPE4 || n->type == TYPE16) {
+		unsigned char *keys = keysOf(n);
+		void **children = childrenOf(n);
+		int i = n->count;
+		while(i > 0 && keys[i-1] > byte) {
+			keys[i] = keys[i-1];
+			children[i] = children[i-1];
+			i--;
+		}
+		keys[i] = byte;
+		children[i] = child;
+	} else if(n->type == TYPE48) {
+		NODE48 *m = (NODE48 *) n;
+		int slot = 0;
+		while(m->children[slot] != NULL)
+			slot++;
+		m->children[slot] = child;
+		m->index[byte] = slot + 1;
+	} else
+		((NODE256 *) n)->children[byte] = child;
+	n->count++;
+}
+/*
+ * Returns a copy of the node with the given size, and frees the original.
+ */
+static NODE *resize(NODE *n, int type) {
+	NODE *m = newNODE(type);
+	*m = *n;
+	m->type = type;
+	m->count = 0;
+	for(int byte=0; byte<256; byte++) {
+		void **child = findChild(n, byte);
+		if(child != NULL)
+			insertChild(m, byte, *child);
+	}
+	free(n);
+	return m;
+}
+/*
+ * Adds a child, replacing the node at ref with a larger one if it is full.
+ */
+static void addChild(void **ref, NODE *n, unsigned char byte, void *child) {
+	static const int capacity[] = { 4, 16, 48, 256 };
+	if(n->count == capacity[n->type]) {
+		n = resize(n, n->type + 1);
+		*ref = n;
+	}
+	insertChild(n, byte, child);
+}
+/*
+ * Removes the child for the byte, replacing the node at ref with a smaller one
+ * once few enough children are left. The thresholds sit below the smaller size's
+ * capacity so that a node does not flip between two sizes.
+ */
+static void removeChild(void **ref, NODE *n, unsigned char byte) {
+	if(n->type == TYPE4 || n->type == TYPE16) {
+		unsigned char *keys = keysOf(n);
+		void **children = childrenOf(n);
+		int i = 0;
+		while(keys[i] != byte)
+			i++;
+		for(; i<n->count-1; i++) {
+			keys[i] = keys[i+1];
+			children[i] = children[i+1];
+		}
+	} else if(n->type == TYPE48) {
+		NODE48 *m = (NODE48 *) n;
+		m->children[m->index[byte]-1] = NULL;
+		m->index[byte] = 0;
+	} else
+		((NODE256 *) n)->children[byte] = NULL;
+	n->count--;
+
+	if(n->type == TYPE16 && n->count <= 3)
+		*ref = resize(n, TYPE4);
+	else if(n->type == TYPE48 && n->count <= 12)
+		*ref = resize(n, TYPE16);
+	else if(n->type == TYPE256 && n->count <= 37)
+		*ref = resize(n, TYPE48);
+}
+/*
+ * Returns the first child of the node in byte order, storing its byte.
+ */
+static void *firstChild(NODE *n, unsigned char *byte) {
+	for(int b=0; b<256; b++) {
+		void **child = findChild(n, b);
+		if(child != NULL) {
+			*byte = b;
+			return *child;
+		}
+	}
+	return NULL;
+}
+/*
+ * Returns the leaf with the smallest key under p. Since every leaf below a node
+ * shares the node's prefix, this is also used to read prefix bytes that were not
+ * kept in the node.
+ */
+static LEAF *minimum(void *p) {
+	unsigned char byte;
+	while(TYPE(p) != TYPELEAF) {
+		NODE *n = p;
+		if(n->end != NULL)
+			return n->end;
+		p = firstChild(n, &byte);
+	}
+	return p;
+}
+/*
+ * Returns the number of bytes of the node's prefix that the key matches from
+ * depth on, stopping early if the key runs out.
+ */
+static int prefixMismatch(ART *t, NODE *n, const unsigned char *key, int length, int depth) {
+	int stored = n->prefixLength < MAX_PREFIX ? n->prefixLength : MAX_PREFIX;
+	int i = 0;
+	for(; i<stored; i++)
+		if(depth+i >= length || n->prefix[i] != key[depth+i])
+			return i;
+	if(n->prefixLength > MAX_PREFIX) {
+		int leafLength;
+		const unsigned char *leafKey = t->key(minimum(n)->value, &leafLength);
+		for(; i<n->prefixLength; i++)
+			if(depth+i >= length || leafKey[depth+i] != key[depth+i])
+				return i;
+	}
+	return i;
+}
+/*
+ * Hangs a leaf off a node, in its end slot if the key ends at depth.
+ */
+static void attach(NODE *n, LEAF *l, const unsigned char *key, int length, int depth) {
+	if(depth == length)
+		n->end = l;
+	else
+		insertChild(n, key[depth], l);
+}
+/*
+ * Replaces a node left with a single entry by that entry. A lone child node
+ * absorbs the node's prefix and the byte that led to it.
+ */
+static void collapse(void **ref) {
+	NODE *n = *ref;
+	if(n->count == 0) {
+		*ref = n->end;
+		free(n);
+		return;
+	}
+	if(n->count > 1 || n->end != NULL)
+		return;
+	unsigned char byte;
+	void *child = firstChild(n, &byte);
+	if(TYPE(child) != TYPELEAF) {
+		NODE *c = child;
+		unsigned char prefix[MAX_PREFIX];
+		int k = 0;
+		for(int i=0; i<n->prefixLength && k<MAX_PREFIX; i++)
+			prefix[k++] = n->prefix[i];
+		if(k < MAX_PREFIX)
+			prefix[k++] = byte;
+		for(int i=0; i<c->prefixLength && k<MAX_PREFIX; i++)
+			prefix[k++] = c->prefix[i];
+		memcpy(c->prefix, prefix, k);
+		c->prefixLength += n->prefixLength + 1;
+	}
+	*ref = child;
+	free(n);
+}
+
+void insertART(ART *t, void *value) {
+	int length;
+	const unsigned char *key = t->key(value, &length);
+	void **ref = &t->root;
+	int depth = 0;
+	t->words++;
+	while(1) {
+		void *p = *ref;
+		if(p == NULL) {
+			*ref = newLEAF(value);
+			t->size++;
+			return;
+		}
+		if(TYPE(p) == TYPELEAF) {
+			LEAF *l = p;
+			int otherLength;
+			const unsigned char *other = t->key(l->value, &otherLength);
+			if(otherLength == length && memcmp(other, key, length) == 0) {
+				l->freq++;
+				return;
+			}
+			//Split the leaf into a node holding both keys after their common bytes
+			int common = 0;
+			while(depth+common < length && depth+common < otherLength
+					&& key[depth+common] == other[depth+common])
+				common++;
+			NODE *n = newNODE(TYPE4);
+			setPrefix(n, key+depth, common);
+			attach(n, l, other, otherLength, depth+common);
+			attach(n, newLEAF(value), key, length, depth+common);
+			*ref = n;
+			t->size++;
+			return;
+		}
+		NODE *n = p;
+		if(n->prefixLength > 0) {
+			int match = prefixMismatch(t, n, key, length, depth);
+			if(match < n->prefixLength) {
+				//Split the prefix, moving the node under a new one for the matched part
+				NODE *m = newNODE(TYPE4);
+				setPrefix(m, key+depth, match);
+				if(n->prefixLength <= MAX_PREFIX) {
+					insertChild(m, n->prefix[match], n);
+					n->prefixLength -= match + 1;
+					memmove(n->prefix, n->prefix+match+1, n->prefixLength);
+				} else {
+					int leafLength;
+					const unsigned char *leafKey = t->key(minimum(n)->value, &leafLength);
+					insertChild(m, leafKey[depth+match], n);
+					setPrefix(n, leafKey+depth+match+1, n->prefixLength - match - 1);
+				}
+				attach(m, newLEAF(value), key, length, depth+match);
+				*ref = m;
+				t->size++;
+				return;
+			}
+			depth += n->prefixLength;
+		}
+		if(depth == length) {
+			if(n->end != NULL)
+				n->end->freq++;
+			else {
+				n->end = newLEAF(value);
+				t->size++;
+			}
+			return;
+		}
+		void **child = findChild(n, key[depth]);
+		if(child == NULL) {
+			addChild(ref, n, key[depth], newLEAF(value));
+			t->size++;
+			return;
+		}
+		ref = child;
+		depth++;
+	}
+}
+/*
+ * Returns the leaf for the key, or NULL if it is not in the tree. Prefix bytes
+ * that were not kept in the nodes are skipped and checked at the leaf.
+ */
+static LEAF *search(ART *t, const unsigned char *key, int length) {
+	void *p = t->root;
+	int depth = 0;
+	while(p != NULL) {
+		if(TYPE(p) == TYPELEAF)
+			return leafMatches(t, p, key, length) ? p : NULL;
+		NODE *n = p;
+		int stored = n->prefixLength < MAX_PREFIX ? n->prefixLength : MAX_PREFIX;
+		for(int i=0; i<stored; i++)
+			if(depth+i >= length || n->prefix[i] != key[depth+i])
+				return NULL;
+		depth += n->prefixLength;
+		if(depth >= length) {
+			if(depth == length && n->end != NULL && leafMatches(t, n->end, key, length))
+				return n->end;
+			return NULL;
+		}
+		void **child = findChild(n, key[depth]);
+		if(child == NULL)
+			return NULL;
+		p = *child;
+		depth++;
+	}
+	return NULL;
+}
+/*
+ * Returns the frequency of the value, or 0 if it is not in the tree.
+ */
+int findART(ART *t, void *value) {
+	int length;
+	const unsigned char *key = t->key(value, &length);
+	LEAF *l = search(t, key, length);
+	return l == NULL ? 0 : l->freq;
+}
+/*
+ * Removes one occurrence of the value. Returns 0 if the value was not in the
+ * tree, and 1 otherwise.
+ */
+int deleteART(ART *t, void *value) {
+	int length;
+	const unsigned char *key = t->key(value, &length);
+	void **ref = &t->root, **parentRef = NULL;
+	int depth = 0;
+	while(*ref != NULL) {
+		void *p = *ref;
+		if(TYPE(p) == TYPELEAF) {
+			LEAF *l = p;
+			if(!leafMatches(t, l, key, length))
+				return 0;
+			t->words--;
+			if(--l->freq == 0) {
+				free(l);
+				t->size--;
+				if(parentRef == NULL)
+					t->root = NULL;
+				else {
+					removeChild(parentRef, *parentRef, key[depth-1]);
+					collapse(parentRef);
+				}
+			}
+			return 1;
+		}
+		NODE *n = p;
+		int stored = n->prefixLength < MAX_PREFIX ? n->prefixLength : MAX_PREFIX;
+		for(int i=0; i<stored; i++)
+			if(depth+i >= length || n->prefix[i] != key[depth+i])
+				return 0;
+		depth += n->prefixLength;
+		if(depth >= length) {
+			LEAF *l = n->end;
+			if(depth > length || l == NULL || !leafMatches(t, l, key, length))
+				return 0;
+			t->words--;
+			if(--l->freq == 0) {
+				free(l);
+				t->size--;
+				n->end = NULL;
+				collapse(ref);
+			}
+			return 1;
+		}
+		void **child = findChild(n, key[depth]);
+		if(child == NULL)
+			return 0;
+		parentRef = ref;
+		ref = child;
+		depth++;
+	}
+	return 0;
+}
+int sizeART(ART *t) {
+	return t->size;
+}
+int wordsART(ART *t) {
+	return t->words;
+}
+
+static void walkNODE(void *p, void (*visit)(void *, long long, void *), void *arg) {
+	if(TYPE(p) == TYPELEAF) {
+		LEAF *l = p;
+		visit(l->value, l->freq, arg);
+		return;
+	}
+	NODE *n = p;
+	//A key ending here is a prefix of, and so sorts before, every key below
+	if(n->end != NULL)
+		visit(n->end->value, n->end->freq, arg);
+	if(n->type == TYPE4 || n->type == TYPE16) {
+		void **children = childrenOf(n);
+		for(int i=0; i<n->count; i++)
+			walkNODE(children[i], visit, arg);
+	} else if(n->type == TYPE48) {
+		NODE48 *m = (NODE48 *) n;
+		for(int b=0; b<256; b++)
+			if(m->index[b] != 0)
+				walkNODE(m->children[m->index[b]-1], visit, arg);
+	} else {
+		NODE256 *m = (NODE256 *) n;
+		for(int b=0; b<256; b++)
+			if(m->children[b] != NULL)
+				walkNODE(m->children[b], visit, arg);
+	}
+}
+/*
+ * Visits every value with its frequency, in the byte order of the keys.
+ */
+void walkART(ART *t, void (*visit)(void *, long long, void *), void *arg) {
+	if(t->root != NULL)
+		walkNODE(t->root, visit, arg);
+}
+/*
+ * Visits, in order, every value whose key starts with the given bytes.
+ */
+void prefixART(ART *t, const unsigned char *prefix, int length,
+		void (*visit)(void *, long long, void *), void *arg) {
+	void *p = t->root;
+	int depth = 0;
+	while(p != NULL) {
+		if(TYPE(p) == TYPELEAF) {
+			LEAF *l = p;
+			int leafLength;
+			const unsigned char *leafKey = t->key(l->value, &leafLength);
+			if(leafLength >= length && memcmp(leafKey, prefix, length) == 0)
+				visit(l->value, l->freq, arg);
+			return;
+		}
+		NODE *n = p;
+		int match = prefixMismatch(t, n, prefix, length, depth);
+		if(depth + match == length) {
+			walkNODE(n, visit, arg);
+			return;
+		}
+		if(match < n->prefixLength)
+			return;
+		depth += n->prefixLength;
+		void **child = findChild(n, prefix[depth]);
+		if(child == NULL)
+			return;
+		p = *child;
+		depth++;
+	}
+}
+
+typedef struct artstats {
+	int nodes[4], leaves, maxDepth;
+	long long bytes;
+} STATS;
+
+static void measure(void *p, int depth, STATS *s) {
+	if(depth > s->maxDepth)
+		s->maxDepth = depth;
+	if(TYPE(p) == TYPELEAF) {
+		s->leaves++;
+		s->bytes += sizeof(LEAF);
+		return;
+	}
+	NODE *n = p;
+	s->nodes[n->type]++;
+	s->bytes += nodeSize[n->type];
+	if(n->end != NULL) {
+		s->leaves++;
+		s->bytes += sizeof(LEAF);
+	}
+	for(int b=0; b<256; b++) {
+		void **child = findChild(n, b);
+		if(child != NULL)
+			measure(*child, depth+1, s);
+	}
+}
+void statisticsART(FILE *fp, ART *t) {
+	STATS s;
+	memset(&s, 0, sizeof(STATS));
+	if(t->root != NULL)
+		measure(t->root, 1, &s);
+	fprintf(fp, "Words/Phrases: %d\n", t->words);
+	fprintf(fp, "Keys: %d\n", t->size);
+	fprintf(fp, "Nodes: %d(%d Node4, %d Node16, %d Node48, %d Node256)\n",
+		s.nodes[0] + s.nodes[1] + s.nodes[2] + s.nodes[3],
+		s.nodes[0], s.nodes[1], s.nodes[2], s.nodes[3]);
+	fprintf(fp, "Maximum depth: %d\n", s.maxDepth);
+	fprintf(fp, "Tree memory: %lld bytes\n", s.bytes);
+}
+
+typedef struct artdisplay {
+	ART *tree;
+	FILE *fp;
+	int first;
+} DISPLAY;
+
+static void displayValue(void *value, long long freq, void *arg) {
+	DISPLAY *d = arg;
+	if(!d->first)
+		fputc(',', d->fp);
+	d->first = 0;
+	d->tree->display(d->fp, value);
+	if(freq > 1)
+		fprintf(d->fp, "-%lld", freq);
+}
+/*
+ * Prints out the values in key order, each followed by its frequency when that
+ * is greater than 1.
+ */
+void displayART(FILE *fp, ART *t) {
+	DISPLAY d;
+	d.tree = t;
+	d.fp = fp;
+	d.first = 1;
+	fputc('[', fp);
+	walkART(t, displayValue, &d);
+	fputs("]\n", fp);
+}
+
+static void freeNODE(void *p) {
+	if(TYPE(p) != TYPELEAF) {
+		NODE *n = p;
+		free(n->end);
+		for(int b=0; b<256; b++) {
+			void **child = findChild(n, b);
+			if(child != NULL)
+				freeNODE(*child);
+		}
+	}
+	free(p);
+}
+/*
+ * Frees the tree. The values themselves are still owned by the caller.
+ */
+void freeART(ART *t) {
+	if(t->root != NULL)
+		freeNODE(t->root);
+	free(t);
+}
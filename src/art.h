@@ -0,0 +1,26 @@
+#ifndef __ART_INCLUDED__
+#define __ART_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct art ART;
+
+extern ART *newART(
+	void (*)(FILE *,void *),           //display
+	const unsigned char *(*)(void *,int *));   //key(value,&length)
+extern void insertART(ART *,void *);
+extern int  findART(ART *,void *);
+extern int  deleteART(ART *,void *);
+extern int  sizeART(ART *);
+extern int  wordsART(ART *);
+extern void walkART(ART *,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void prefixART(ART *,const unsigned char *prefix,int length,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void statisticsART(FILE *,ART *);
+extern void displayART(FILE *,ART *);
+extern void freeART(ART *);
+
+#endif
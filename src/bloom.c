@@ -0,0 +1,125 @@
+#include "bloom.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contains the implementation for a blocked Bloom filter over 32-bit hashes. The
+ * bits are split into 512-bit blocks, each one cache line. A hash picks one
+ * block and sets or tests all of its bits inside it, so a check touches a
+ * single cache line no matter how many bits are used per key. The filter can
+ * say a hash was never added, or that it may have been; it cannot remove keys.
+ */
+
+#define BLOCK_BITS 512
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+#define MAX_HASHES 16
+
+struct bloom {
+	unsigned long long *blocks;     //aligned to a cache line within memory
+	void *memory;
+	int blockCount, hashes, keys, capacity;
+};
+
+/*
+ * Sizes the filter for capacity keys at bitsPerKey bits each, using the number
+ * of bits per key that minimizes false positives, bitsPerKey * ln 2.
+ */
+BLOOM *newBLOOM(int capacity, int bitsPerKey) {
+	assert(capacity > 0 && bitsPerKey > 0);
+	BLOOM *b = malloc(sizeof(BLOOM));
+	assert(b != 0);
+
+	long long bits = (long long) capacity * bitsPerKey;
+	b->blockCount = (int) ((bits + BLOCK_BITS - 1) / BLOCK_BITS);
+	b->hashes = (bitsPerKey * 693 + 500) / 1000;
+	if(b->hashes < 1)
+		b->hashes = 1;
+	if(b->hashes > MAX_HASHES)
+		b->hashes = MAX_HASHES;
+	b->memory = malloc(sizeof(unsigned long long) * BLOCK_WORDS * b->blockCount + 64);
+	assert(b->memory != 0);
+	b->blocks = (unsigned long long *) (((size_t) b->memory + 63) & ~(size_t) 63);
+	b->capacity = capacity;
+	clearBLOOM(b);
+	return b;
+}
+
+/*
+ * Spreads the 32-bit hash over 64 bits. The high half picks the block and the
+ * low half seeds the bit positions inside it.
+ */
+static unsigned long long mix(unsigned hash) {
+	unsigned long long h = hash;
+	h ^= h >> 16;
+	h *= 0x9E3779B97F4A7C15ULL;
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 32;
+	return h;
+}
+static unsigned long long *blockOf(BLOOM *b, unsigned long long h) {
+	int block = (int) (((h >> 32) * (unsigned long long) b->blockCount) >> 32);
+	return b->blocks + (size_t) block * BLOCK_WORDS;
+}
+
+void addBLOOM(BLOOM *b, unsigned hash) {
+	unsigned long long h = mix(hash);
+	unsigned long long *block = blockOf(b, h);
+	unsigned bit = (unsigned) h, step = (unsigned) (h >> 9) | 1;
+	for(int i=0; i<b->hashes; i++) {
+		unsigned at = bit % BLOCK_BITS;
+		block[at / 64] |= 1ULL << (at % 64);
+		bit += step;
+	}
+	b->keys++;
+}
+/*
+ * Returns 0 if the hash was never added, and 1 if it may have been.
+ */
+int checkBLOOM(BLOOM *b, unsigned hash) {
+	unsigned long long h = mix(hash);
+	unsigned long long *block = blockOf(b, h);
+	unsigned bit = (unsigned) h, step = (unsigned) (h >> 9) | 1;
+	for(int i=0; i<b->hashes; i++) {
+		unsigned at = bit % BLOCK_BITS;
+		if((block[at / 64] & (1ULL << (at % 64))) == 0)
+			return 0;
+		bit += step;
+	}
+	return 1;
+}
+void clearBLOOM(BLOOM *b) {
+	memset(b->blocks, 0, sizeof(unsigned long long) * BLOCK_WORDS * b->blockCount);
+	b->keys = 0;
+}
+int keysBLOOM(BLOOM *b) {
+	return b->keys;
+}
+int capacityBLOOM(BLOOM *b) {
+	return b->capacity;
+}
+/*
+ * Estimates the false positive rate from the fraction of bits that are set,
+ * raised to the number of bits tested per check.
+ */
+double estimateBLOOM(BLOOM *b) {
+	long long set = 0, total = (long long) b->blockCount * BLOCK_BITS;
+	for(long long i=0; i<(long long) b->blockCount * BLOCK_WORDS; i++)
+		for(unsigned long long word = b->blocks[i]; word != 0; word &= word - 1)
+			set++;
+	double fill = (double) set / total, rate = 1.0;
+	for(int i=0; i<b->hashes; i++)
+		rate *= fill;
+	return rate;
+}
+void statisticsBLOOM(FILE *fp, BLOOM *b) {
+	fprintf(fp, "Filter keys: %d/%d\n", b->keys, b->capacity);
+	fprintf(fp, "Filter bits: %lld\n", (long long) b->blockCount * BLOCK_BITS);
+	fprintf(fp, "Filter hashes: %d\n", b->hashes);
+	fprintf(fp, "Estimated false positive rate: %.2f%%\n", 100.0 * estimateBLOOM(b));
+}
+void freeBLOOM(BLOOM *b) {
+	free(b->memory);
+	free(b);
+}
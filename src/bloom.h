@@ -0,0 +1,18 @@
+#ifndef __BLOOM_INCLUDED__
+#define __BLOOM_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct bloom BLOOM;
+
+extern BLOOM *newBLOOM(int capacity,int bitsPerKey);
+extern void addBLOOM(BLOOM *b,unsigned hash);
+extern int  checkBLOOM(BLOOM *b,unsigned hash);
+extern void clearBLOOM(BLOOM *b);
+extern int  keysBLOOM(BLOOM *b);
+extern int  capacityBLOOM(BLOOM *b);
+extern double estimateBLOOM(BLOOM *b);
+extern void statisticsBLOOM(FILE *fp,BLOOM *b);
+extern void freeBLOOM(BLOOM *b);
+
+#endif
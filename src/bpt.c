@@ -0,0 +1,451 @@
+#include "bpt.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contains the implementation for a B+ tree that counts the frequency of each
+ * value, like the RBT and GT. Every node holds many keys in one allocation, so
+ * far fewer nodes are touched per search and there are no per-key pointers.
+ * Values and frequencies live in the leaves, which are linked in order for range
+ * scans. Internal nodes only hold separator keys: every key under children[i]
+ * is less than keys[i], and every key under children[i+1] is at least keys[i].
+ *
+ * The fanout is given in cache lines of key pointers. Nodes never hold fewer
+ * than half the fanout keys, except for the root.
+ */
+
+#define DEFAULT_LINES 4
+#define CACHE_LINE 64
+
+typedef struct bptnode BPTNODE;
+struct bptnode {
+	int leaf, count;
+	void **keys;
+	int *freqs;                //leaves only
+	BPTNODE **children;        //internal nodes only
+	BPTNODE *next, *prev;      //leaves only
+};
+
+struct bpt {
+	BPTNODE *root;
+	int fanout, size, numWords, nodes;
+	long bytes;
+	void (*display)(FILE *, void *);
+	int (*compare)(void *, void *);
+};
+
+/*
+ * Creates a node with its key array, and its frequency or child array, placed
+ * right after it in the same allocation. There is room for one extra key so a
+ * node can overflow briefly before it is split.
+ */
+static BPTNODE *newBPTNODE(BPT *t, int leaf) {
+	size_t bytes = sizeof(BPTNODE) + sizeof(void *) * (t->fanout+1);
+	if(leaf)
+		bytes += sizeof(int) * (t->fanout+1);
+	else
+		bytes += sizeof(BPTNODE *) * (t->fanout+2);
+	BPTNODE *n = malloc(bytes);
+	assert(n != 0);
+
+	n->leaf = leaf;
+	n->count = 0;
+	n->keys = (void **) (n+1);
+	n->freqs = NULL;
+	n->children = NULL;
+	if(leaf)
+		n->freqs = (int *) (n->keys + t->fanout+1);
+	else
+		n->children = (BPTNODE **) (n->keys + t->fanout+1);
+	n->next = NULL;
+	n->prev = NULL;
+	t->nodes++;
+	t->bytes += bytes;
+	return n;
+}
+static void freeBPTNODE(BPT *t, BPTNODE *n) {
+	t->bytes -= sizeof(BPTNODE) + sizeof(void *) * (t->fanout+1)
+		+ (n->leaf ? sizeof(int) * (t->fanout+1) : sizeof(BPTNODE *) * (t->fanout+2));
+	free(n);
+	t->nodes--;
+}
+
+BPT *newBPT(void (*d)(FILE *, void *), int (*c)(void *, void *), int lines) {
+	BPT *t = malloc(sizeof(BPT));
+	assert(t != 0);
+
+	if(lines <= 0)
+		lines = DEFAULT_LINES;
+	t->fanout = lines * CACHE_LINE / sizeof(void *);
+	if(t->fanout < 3)
+		t->fanout = 3;
+	t->root = NULL;
+	t->size = 0;
+	t->numWords = 0;
+	t->nodes = 0;
+	t->bytes = 0;
+	t->display = d;
+	t->compare = c;
+	return t;
+}
+
+/*
+ * Returns the index of the first key in the node not less than the value, and
+ * sets found if that key is equal to it.
+ */
+static int searchKeys(BPT *t, BPTNODE *n, void *value, int *found) {
+	int lo = 0, hi = n->count;
+	*found = 0;
+	while(lo < hi) {
+		int mid = lo + (hi-lo)/2;
+		int comparison = t->compare(n->keys[mid], value);
+		if(comparison < 0)
+			lo = mid+1;
+		else {
+			if(comparison == 0)
+				*found = 1;
+			hi = mid;
+		}
+	}
+	return lo;
+}
+/*
+ * Returns the index of the child of an internal node that may hold the value.
+ */
+static int childIndex(BPT *t, BPTNODE *n, void *value) {
+	int found;
+	int i = searchKeys(t, n, value, &found);
+	return found ? i+1 : i;
+}
+static BPTNODE *findLeaf(BPT *t, void *value) {
+	BPTNODE *n = t->root;
+	while(n != NULL && !n->leaf)
+		n = n->children[childIndex(t, n, value)];
+	return n;
+}
+
+/*
+ * Moves the upper half of an overflowing leaf into a new right sibling and
+ * returns it. The separator is the first key of the new leaf.
+ */
+static BPTNODE *splitLeaf(BPT *t, BPTNODE *n, void **sep) {
+	BPTNODE *right = newBPTNODE(t, 1);
+	int half = n->count / 2;
+	right->count = n->count - half;
+	memcpy(right->keys, n->keys + half, sizeof(void *) * right->count);
+	memcpy(right->freqs, n->freqs + half, sizeof(int) * right->count);
+	n->count = half;
+
+	right->next = n->next;
+	right->prev = n;
+	if(n->next != NULL)
+		n->next->prev = right;
+	n->next = right;
+	*sep = right->keys[0];
+	return right;
+}
+/*
+ * Moves the keys and children above the middle key of an overflowing internal
+ * node into a new right sibling and returns it. The middle key moves up as the
+ * separator.
+ */
+static BPTNODE *splitInternal(BPT *t, BPTNODE *n, void **sep) {
+	BPTNODE *right = newBPTNODE(t, 0);
+	int mid = n->count / 2;
+	*sep = n->keys[mid];
+	right->count = n->count - mid - 1;
+	memcpy(right->keys, n->keys + mid+1, sizeof(void *) * right->count);
+	memcpy(right->children, n->children + mid+1, sizeof(BPTNODE *) * (right->count+1));
+	n->count = mid;
+	return right;
+}
+/*
+ * Inserts the value below the node. If the node had to split, the new right
+ * sibling is returned and its separator is stored in sep.
+ */
+static BPTNODE *insertNode(BPT *t, BPTNODE *n, void *value, void **sep) {
+	int found;
+	int i = searchKeys(t, n, value, &found);
+	if(n->leaf) {
+		if(found) {
+			n->freqs[i]++;
+			return NULL;
+		}
+		memmove(n->keys + i+1, n->keys + i, sizeof(void *) * (n->count-i));
+		memmove(n->freqs + i+1, n->freqs + i, sizeof(int) * (n->count-i));
+		n->keys[i] = value;
+		n->freqs[i] = 1;
+		n->count++;
+		t->size++;
+		return n->count > t->fanout ? splitLeaf(t, n, sep) : NULL;
+	}
+
+	int c = found ? i+1 : i;
+	void *childSep;
+	BPTNODE *right = insertNode(t, n->children[c], value, &childSep);
+	if(right == NULL)
+		return NULL;
+	memmove(n->keys + c+1, n->keys + c, sizeof(void *) * (n->count-c));
+	memmove(n->children + c+2, n->children + c+1, sizeof(BPTNODE *) * (n->count-c));
+	n->keys[c] = childSep;
+	n->children[c+1] = right;
+	n->count++;
+	return n->count > t->fanout ? splitInternal(t, n, sep) : NULL;
+}
+void insertBPT(BPT *t, void *value) {
+	if(t->root == NULL)
+		t->root = newBPTNODE(t, 1);
+	void *sep;
+	BPTNODE *right = insertNode(t, t->root, value, &sep);
+	if(right != NULL) {
+		//The root split, so the tree grows a level
+		BPTNODE *root = newBPTNODE(t, 0);
+		root->count = 1;
+		root->keys[0] = sep;
+		root->children[0] = t->root;
+		root->children[1] = right;
+		t->root = root;
+	}
+	t->numWords++;
+}
+/*
+ * Returns the frequency of the value, or 0 if it is not in the tree.
+ */
+int findBPT(BPT *t, void *value) {
+	BPTNODE *leaf = findLeaf(t, value);
+	if(leaf == NULL)
+		return 0;
+	int found;
+	int i = searchKeys(t, leaf, value, &found);
+	return found ? leaf->freqs[i] : 0;
+}
+
+/*
+ * Merges the child at c+1 into the child at c, pulling their separator down for
+ * internal nodes, and removes the separator from the parent.
+ */
+static void mergeChildren(BPT *t, BPTNODE *parent, int c) {
+	BPTNODE *left = parent->children[c], *right = parent->children[c+1];
+	if(left->leaf) {
+		memcpy(left->keys + left->count, right->keys, sizeof(void *) * right->count);
+		memcpy(left->freqs + left->count, right->freqs, sizeof(int) * right->count);
+		left->count += right->count;
+		left->next = right->next;
+		if(right->next != NULL)
+			right->next->prev = left;
+	} else {
+		left->keys[left->count] = parent->keys[c];
+		memcpy(left->keys + left->count+1, right->keys, sizeof(void *) * right->count);
+		memcpy(left->children + left->count+1, right->children,
+			sizeof(BPTNODE *) * (right->count+1));
+		left->count += right->count + 1;
+	}
+	memmove(parent->keys + c, parent->keys + c+1, sizeof(void *) * (parent->count-c-1));
+	memmove(parent->children + c+1, parent->children + c+2,
+		sizeof(BPTNODE *) * (parent->count-c-1));
+	parent->count--;
+	freeBPTNODE(t, right);
+}
+/*
+ * Refills the child at c, which has fallen below the minimum, by borrowing a key
+ * from a sibling that can spare one, or else by merging it with a sibling.
+ */
+static void rebalance(BPT *t, BPTNODE *parent, int c) {
+	int min = t->fanout / 2;
+	BPTNODE *child = parent->children[c];
+	BPTNODE *left = c > 0 ? parent->children[c-1] : NULL;
+	BPTNODE *right = c < parent->count ? parent->children[c+1] : NULL;
+
+	if(left != NULL && left->count > min) {
+		memmove(child->keys + 1, child->keys, sizeof(void *) * child->count);
+		if(child->leaf) {
+			memmove(child->freqs + 1, child->freqs, sizeof(int) * child->count);
+			child->keys[0] = left->keys[left->count-1];
+			child->freqs[0] = left->freqs[left->count-1];
+			parent->keys[c-1] = child->keys[0];
+		} else {
+			memmove(child->children + 1, child->children, sizeof(BPTNODE *) * (child->count+1));
+			child->keys[0] = parent->keys[c-1];
+			child->children[0] = left->children[left->count];
+			parent->keys[c-1] = left->keys[left->count-1];
+		}
+		child->count++;
+		left->count--;
+	} else if(right != NULL && right->count > min) {
+		if(child->leaf) {
+			child->keys[child->count] = right->keys[0];
+			child->freqs[child->count] = right->freqs[0];
+			memmove(right->keys, right->keys + 1, sizeof(void *) * (right->count-1));
+			memmove(right->freqs, right->freqs + 1, sizeof(int) * (right->count-1));
+			parent->keys[c] = right->keys[0];
+		} else {
+			child->keys[child->count] = parent->keys[c];
+			child->children[child->count+1] = right->children[0];
+			parent->keys[c] = right->keys[0];
+			memmove(right->keys, right->keys + 1, sizeof(void *) * (right->count-1));
+			memmove(right->children, right->children + 1, sizeof(BPTNODE *) * right->count);
+		}
+		child->count++;
+		right->count--;
+	} else if(left != NULL)
+		mergeChildren(t, parent, c-1);
+	else
+		mergeChildren(t, parent, c);
+}
+/*
+ * Removes a value that is known to be in the leaves below the node. A separator
+ * equal to the value is the smallest key of the subtree to its right, so it is
+ * replaced on the way down by the successor that takes that place, and no
+ * internal node keeps a pointer to the removed value. The successor is NULL
+ * when the value is the largest key; its separator then sits over a leaf holding
+ * only the value, and the rebalance below overwrites or removes it.
+ */
+static void deleteNode(BPT *t, BPTNODE *n, void *value, void *successor) {
+	if(n->leaf) {
+		int found;
+		int i = searchKeys(t, n, value, &found);
+		memmove(n->keys + i, n->keys + i+1, sizeof(void *) * (n->count-i-1));
+		memmove(n->freqs + i, n->freqs + i+1, sizeof(int) * (n->count-i-1));
+		n->count--;
+		t->size--;
+		return;
+	}
+	int found;
+	int i = searchKeys(t, n, value, &found);
+	if(found && successor != NULL)
+		n->keys[i] = successor;
+	int c = found ? i+1 : i;
+	deleteNode(t, n->children[c], value, successor);
+	if(n->children[c]->count < t->fanout / 2)
+		rebalance(t, n, c);
+}
+/*
+ * Removes one occurrence of the value. Returns 1 if it was found and 0 otherwise.
+ * Once the last occurrence is removed the tree holds no pointer to the value, in
+ * the leaves or in the separators, so the caller may free it.
+ */
+int deleteBPT(BPT *t, void *value) {
+	BPTNODE *leaf = findLeaf(t, value);
+	if(leaf == NULL)
+		return 0;
+	int found;
+	int i = searchKeys(t, leaf, value, &found);
+	if(!found)
+		return 0;
+	t->numWords--;
+	if(leaf->freqs[i] > 1) {
+		leaf->freqs[i]--;
+		return 1;
+	}
+
+	void *successor = i+1 < leaf->count ? leaf->keys[i+1]
+		: leaf->next != NULL ? leaf->next->keys[0] : NULL;
+	deleteNode(t, t->root, value, successor);
+	if(!t->root->leaf && t->root->count == 0) {
+		//The root lost its last separator, so the tree shrinks a level
+		BPTNODE *old = t->root;
+		t->root = old->children[0];
+		freeBPTNODE(t, old);
+	} else if(t->root->leaf && t->root->count == 0) {
+		freeBPTNODE(t, t->root);
+		t->root = NULL;
+	}
+	return 1;
+}
+int sizeBPT(BPT *t) {
+	return t->size;
+}
+int wordsBPT(BPT *t) {
+	return t->numWords;
+}
+/*
+ * Visits every value in [lo, hi] in order, passing its frequency along. After
+ * one descent the scan only follows the leaf links.
+ */
+void rangeBPT(BPT *t, void *lo, void *hi, void (*visit)(void *, long long, void *), void *arg) {
+	BPTNODE *leaf = findLeaf(t, lo);
+	if(leaf == NULL)
+		return;
+	int found;
+	int i = searchKeys(t, leaf, lo, &found);
+	while(leaf != NULL) {
+		for(; i<leaf->count; i++) {
+			if(t->compare(leaf->keys[i], hi) > 0)
+				return;
+			visit(leaf->keys[i], leaf->freqs[i], arg);
+		}
+		leaf = leaf->next;
+		i = 0;
+	}
+}
+/*
+ * Prints out the number of words, values, nodes, the height, the fanout and the
+ * memory used by the nodes.
+ */
+void statisticsBPT(FILE *fp, BPT *t) {
+	int height = 0;
+	for(BPTNODE *n = t->root; n != NULL; n = n->leaf ? NULL : n->children[0])
+		height++;
+	fprintf(fp, "Words/Phrases: %d\n", t->numWords);
+	fprintf(fp, "Keys: %d\n", t->size);
+	fprintf(fp, "Nodes: %d\n", t->nodes);
+	fprintf(fp, "Height: %d\n", height);
+	fprintf(fp, "Fanout: %d\n", t->fanout);
+	fprintf(fp, "Node memory: %ld bytes\n", t->bytes);
+}
+/*
+ * Displays the nodes level by level, each as a bracketed list of its keys.
+ * Leaf keys are followed by their frequency when it is greater than 1.
+ */
+void displayBPT(FILE *fp, BPT *t) {
+	if(t->root == NULL) {
+		fputs("EMPTY\n", fp);
+		return;
+	}
+	BPTNODE **nodes = malloc(sizeof(BPTNODE *) * t->nodes);
+	assert(nodes != 0);
+	int head = 0, tail = 0, levelEnd = 1, level = 0;
+	nodes[tail++] = t->root;
+
+	fputs("0: ", fp);
+	while(head < tail) {
+		BPTNODE *n = nodes[head++];
+		fputc('[', fp);
+		for(int i=0; i<n->count; i++) {
+			if(i > 0)
+				fputc(',', fp);
+			t->display(fp, n->keys[i]);
+			if(n->leaf && n->freqs[i] > 1)
+				fprintf(fp, "-%d", n->freqs[i]);
+		}
+		fputc(']', fp);
+		if(!n->leaf)
+			for(int i=0; i<=n->count; i++)
+				nodes[tail++] = n->children[i];
+
+		if(head == tail)
+			fputc('\n', fp);
+		else if(head == levelEnd) {
+			level++;
+			levelEnd = tail;
+			fprintf(fp, "\n%d: ", level);
+		} else
+			fputc(' ', fp);
+	}
+	free(nodes);
+}
+static void freeSubtree(BPT *t, BPTNODE *n) {
+	if(!n->leaf)
+		for(int i=0; i<=n->count; i++)
+			freeSubtree(t, n->children[i]);
+	freeBPTNODE(t, n);
+}
+/*
+ * Frees the tree and its nodes. The values are still owned by the caller.
+ */
+void freeBPT(BPT *t) {
+	if(t->root != NULL)
+		freeSubtree(t, t->root);
+	free(t);
+}
@@ -0,0 +1,24 @@
+#ifndef __BPT_INCLUDED__
+#define __BPT_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct bpt BPT;
+
+extern BPT *newBPT(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	int lines);                        //cache lines of keys per node, 0 for default
+extern void insertBPT(BPT *,void *);
+extern int findBPT(BPT *,void *);
+extern int deleteBPT(BPT *,void *);
+extern int sizeBPT(BPT *);
+extern int wordsBPT(BPT *);
+extern void rangeBPT(BPT *,void *lo,void *hi,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void statisticsBPT(FILE *,BPT *);
+extern void displayBPT(FILE *,BPT *);
+extern void freeBPT(BPT *);
+
+#endif
@@ -1,18 +1,40 @@
 #include "bst.h"
-#include "queue.h"
 #include <assert.h>
 #include <stdlib.h>
 
+/*
+ * Child links and the root are written with release stores, and searchBST reads
+ * them with acquire loads. A thread searching while another one changes the tree
+ * therefore never reaches a node whose fields are not yet written. Every
+ * rotation stores its links in an order that never forms a cycle.
+ */
+#ifdef __GNUC__
+#define PUBLISH(link, node) __atomic_store_n(&(link), (node), __ATOMIC_RELEASE)
+#define OBSERVE(link) __atomic_load_n(&(link), __ATOMIC_ACQUIRE)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PUBLISH(link, node) ((link) = (node))
+#define OBSERVE(link) (link)
+#define PREFETCH(p)
+#endif
+
+//The number of searches findManyBST interleaves
+#define FIND_GROUP 8
+
 /*
  * Written by Zach Wassynger on October 4th, 2017. Contains implementation for a
  * Binary Search Tree that can hold BSTNODEs.
  * Also contains implementation for the BSTNODE that the BST uses. Has parent, left,
  * and right pointers. Stores its generic value as a void pointer.
+ * Every node also tracks the number of nodes in its subtree and their total
+ * weight, which gives rank and select queries in time proportional to the height.
  */
 
 struct bstnode {
 	void *value;
 	BSTNODE *parent, *left, *right;
+	int count;
+	long long weight;
 };
 
 static BSTNODE *newBSTNODE(void *value) {
@@ -23,6 +45,8 @@ static BSTNODE *newBSTNODE(void *value) {
 	node->left = NULL;
 	node->right = NULL;
 	node->parent = NULL;
+	node->count = 1;
+	node->weight = 1;
 
 	return node;
 }
@@ -68,16 +92,19 @@ static void bstSwapper(BSTNODE *x, BSTNODE *y) {
 	x->value = y->value;
 	y->value = temp;
 }
-static int inorderSizeBST(BSTNODE *node);
 
 struct bst {
 	void (*display)(FILE *, void *);
 	int (*compare)(void *, void *);
 	void (*swap)(BSTNODE *,BSTNODE *);
+	long long (*weigh)(void *);
 
 	BSTNODE *root;
+	BSTNODE *first, *last;  //the leftmost and rightmost nodes
 	int size;
 };
+static BSTNODE *leftmost(BSTNODE *node);
+static BSTNODE *rightmost(BSTNODE *node);
 
 BST *newBST(void (*d)(FILE *,void *), int (*c)(void *,void *), void (*s)(BSTNODE *,BSTNODE *)) {
 	BST *p = (BST *) malloc(sizeof(BST));
@@ -87,7 +114,10 @@ BST *newBST(void (*d)(FILE *,void *), int (*c)(void *,void *), void (*s)(BSTNODE
 	p->display = d;
 	p->compare = c;
 	p->root = NULL;
+	p->first = NULL;
+	p->last = NULL;
 	p->size = 0;
+	p->weigh = NULL;
 	if(s == NULL)
 		p->swap = bstSwapper;
 	else
@@ -95,44 +125,107 @@ BST *newBST(void (*d)(FILE *,void *), int (*c)(void *,void *), void (*s)(BSTNODE
 
 	return p;
 }
+/*
+ * Sets the function giving the weight of a value, which the subtree weights are
+ * summed from. Without one every value weighs 1. Must be set while the tree is empty.
+ */
+void setBSTweight(BST *bst, long long (*w)(void *)) {
+	assert(bst->root == NULL);
+	bst->weigh = w;
+}
+static long long ownWeight(BST *bst, BSTNODE *node) {
+	if(bst->weigh == NULL)
+		return 1;
+	return bst->weigh(node->value);
+}
+int getBSTNODEcount(BSTNODE *node) {
+	return node == NULL ? 0 : node->count;
+}
+long long getBSTNODEweight(BSTNODE *node) {
+	return node == NULL ? 0 : node->weight;
+}
+/*
+ * Recomputes the subtree count and weight of the node from its children. Must be
+ * called on a node whose children changed, such as after a rotation, lowest first.
+ */
+void updateBSTNODE(BST *bst, BSTNODE *node) {
+	node->count = 1 + getBSTNODEcount(node->left) + getBSTNODEcount(node->right);
+	node->weight = ownWeight(bst, node)
+		+ getBSTNODEweight(node->left) + getBSTNODEweight(node->right);
+}
+/*
+ * Adds delta to the subtree weight of the node and all of its ancestors. Must be
+ * called whenever the weight of the node's own value changes.
+ */
+void adjustBSTNODEweight(BST *bst, BSTNODE *node, long long delta) {
+	while(1) {
+		node->weight += delta;
+		if(node == bst->root)
+			break;
+		node = node->parent;
+	}
+}
+/*
+ * Replaces the whole tree with the subtree under newRoot, which may be NULL. The
+ * size is read back from the new root's subtree count, and the leftmost and
+ * rightmost nodes are found again by walking down from it.
+ */
 void setBSTroot(BST *bst, BSTNODE *newRoot) {
-	newRoot->parent = newRoot;
-	bst->root = newRoot;
+	if(newRoot != NULL)
+		newRoot->parent = newRoot;
+	PUBLISH(bst->root, newRoot);
+	bst->first = newRoot == NULL ? NULL : leftmost(newRoot);
+	bst->last = newRoot == NULL ? NULL : rightmost(newRoot);
+	bst->size = getBSTNODEcount(newRoot);
 }
 BSTNODE *getBSTroot(BST *bst) {
 	return bst->root;
 }
 BSTNODE *insertBST(BST *bst, void *p) {
 	BSTNODE *newNode = newBSTNODE(p);
+	long long weight = ownWeight(bst, newNode);
+	newNode->weight = weight;
 	if(bst->root == NULL) {
-		bst->root = newNode;
 		newNode->parent = newNode;
+		PUBLISH(bst->root, newNode);
+		bst->first = newNode;
+		bst->last = newNode;
 	}
 	else {
-		int done = 0;
+		int done = 0, allLeft = 1, allRight = 1;
 		BSTNODE *temp = bst->root;
 		while(done == 0) {
+			//Every node on the path gains the new node in its subtree
+			temp->count++;
+			temp->weight += weight;
 			if(bst->compare(newNode->value,temp->value) <= 0) {
 				//When the key is less than temp's key
+				allRight = 0;
 				if(temp->left == NULL) {
 					//Sets the left child of temp to the created node
-					temp->left = newNode;
 					newNode->parent = temp;
+					PUBLISH(temp->left, newNode);
 					done = 1;
 				} else {
 					//Resets at the top with temp being the left child of old temp
 					temp = temp->left;
 				}
 			} else {
+				allLeft = 0;
 				if(temp->right == NULL) {
-					temp->right = newNode;
 					newNode->parent = temp;
+					PUBLISH(temp->right, newNode);
 					done = 1;
 				} else {
 					temp = temp->right;
 				}
 			}
 		}
+		//A node reached by only going left, or only right, is a new extreme
+		if(allLeft)
+			bst->first = newNode;
+		if(allRight)
+			bst->last = newNode;
 	}
 	bst->size++;
 	return newNode;
@@ -158,6 +251,72 @@ BSTNODE *findBST(BST *bst, void *p) {
 	//Value was not found, return NULL
 	return NULL;
 }
+/*
+ * Looks up every value of the batch, storing the node found for values[i], or
+ * NULL, in found[i]. Up to FIND_GROUP searches are walked one level at a time
+ * in turn, and each next node is prefetched as soon as its address is known,
+ * so the cache misses of the different searches overlap instead of stalling one
+ * after another. A finished search hands its slot to the next value.
+ */
+void findManyBST(BST *bst, void **values, int size, BSTNODE **found) {
+	BSTNODE *cursor[FIND_GROUP];
+	int index[FIND_GROUP];
+	int slots = 0, next = 0;
+	PREFETCH(bst->root);
+	while(slots < FIND_GROUP && next < size) {
+		cursor[slots] = bst->root;
+		index[slots++] = next++;
+	}
+	while(slots > 0) {
+		//The nodes were prefetched a round ago; now fetch the values they hold
+		for(int i=0; i<slots; i++)
+			if(cursor[i] != NULL)
+				PREFETCH(cursor[i]->value);
+		int i = 0;
+		while(i < slots) {
+			BSTNODE *node = cursor[i];
+			int comparison = 0;
+			if(node != NULL) {
+				comparison = bst->compare(values[index[i]], node->value);
+				if(comparison != 0) {
+					cursor[i] = comparison < 0 ? node->left : node->right;
+					PREFETCH(cursor[i]);
+					i++;
+					continue;
+				}
+			}
+			found[index[i]] = node;
+			if(next < size) {
+				cursor[i] = bst->root;
+				index[i] = next++;
+				i++;
+			} else {
+				slots--;
+				cursor[i] = cursor[slots];
+				index[i] = index[slots];
+			}
+		}
+	}
+}
+/*
+ * Searches like findBST, but may run while another thread changes the tree.
+ * Follows at most the given number of links, then gives up and returns 0.
+ * Otherwise stores the node found, or NULL, and returns 1. The result is only
+ * meaningful if the caller can tell that no change overlapped the search.
+ */
+int searchBST(BST *bst, void *p, int steps, BSTNODE **found) {
+	BSTNODE *temp = OBSERVE(bst->root);
+	while(temp != NULL && steps-- > 0) {
+		int comparison = bst->compare(p,temp->value);
+		if(comparison == 0)
+			break;
+		temp = comparison < 0 ? OBSERVE(temp->left) : OBSERVE(temp->right);
+	}
+	if(steps < 0)
+		return 0;
+	*found = temp;
+	return 1;
+}
 BSTNODE *deleteBST(BST *bst, void *value) {
 	BSTNODE *node = findBST(bst, value);
 	if(node == NULL) {
@@ -185,17 +344,77 @@ static BSTNODE *findSuccessor(BSTNODE *node) {
 		node = node->left;
 	return node;
 }
+/*
+ * Rotates the right child of the node up into its place. The in-order sequence
+ * of the nodes is unchanged, and the subtree totals of the two nodes involved
+ * are recomputed.
+ */
+void rotateLeftBST(BST *bst, BSTNODE *node) {
+	BSTNODE *right = node->right;
+	PUBLISH(node->right, right->left);
+	if(right->left != NULL)
+		right->left->parent = node;
+	if(node == bst->root) {
+		right->parent = right;
+		PUBLISH(bst->root, right);
+	} else {
+		right->parent = node->parent;
+		if(node == node->parent->left)
+			PUBLISH(node->parent->left, right);
+		else
+			PUBLISH(node->parent->right, right);
+	}
+	PUBLISH(right->left, node);
+	node->parent = right;
+	updateBSTNODE(bst, node);
+	updateBSTNODE(bst, right);
+}
+/*
+ * Rotates the left child of the node up into its place.
+ */
+void rotateRightBST(BST *bst, BSTNODE *node) {
+	BSTNODE *left = node->left;
+	PUBLISH(node->left, left->right);
+	if(left->right != NULL)
+		left->right->parent = node;
+	if(node == bst->root) {
+		left->parent = left;
+		PUBLISH(bst->root, left);
+	} else {
+		left->parent = node->parent;
+		if(node == node->parent->left)
+			PUBLISH(node->parent->left, left);
+		else
+			PUBLISH(node->parent->right, left);
+	}
+	PUBLISH(left->right, node);
+	node->parent = left;
+	updateBSTNODE(bst, node);
+	updateBSTNODE(bst, left);
+}
+/*
+ * Recomputes the weights of the nodes from below up to, but not including, top.
+ * Swapping values between top and below only changes those subtrees.
+ */
+static void refreshWeights(BST *t, BSTNODE *below, BSTNODE *top) {
+	while(below != top) {
+		updateBSTNODE(t, below);
+		below = below->parent;
+	}
+}
 BSTNODE *swapToLeafBST(BST *t, BSTNODE *node) {
 	if(node->left == NULL && node->right == NULL)
 		return node;
 	BSTNODE *pred = findPredecessor(node);
 	if(pred != NULL) {
 		t->swap(pred, node);
+		refreshWeights(t, pred, node);
 		return swapToLeafBST(t, pred);
 	}
 
 	BSTNODE *succ = findSuccessor(node);
 	t->swap(succ, node);
+	refreshWeights(t, succ, node);
 	return swapToLeafBST(t, succ);
 }
 void pruneLeafBST(BST *bst, BSTNODE *node) {
@@ -203,140 +422,361 @@ void pruneLeafBST(BST *bst, BSTNODE *node) {
 	if(node->left != NULL || node->right != NULL)
 		node = swapToLeafBST(bst, node);
 	if(node == bst->root) {
-		bst->root = NULL;
+		PUBLISH(bst->root, NULL);
+		bst->first = NULL;
+		bst->last = NULL;
 		bst->size = 0;
 		return;
 	}
 	BSTNODE *parent = node->parent;
+	//The leftmost leaf is a left child, so its parent comes next, and the
+	//rightmost likewise
+	if(node == bst->first)
+		bst->first = parent;
+	if(node == bst->last)
+		bst->last = parent;
 	//Checks if the node is a left or right child
 	if(node == parent->left)
-		parent->left = NULL;
+		PUBLISH(parent->left, NULL);
 	else
-		parent->right = NULL;
+		PUBLISH(parent->right, NULL);
+	//Removes the leaf from the subtree totals of its ancestors
+	for(BSTNODE *up = parent; ; up = up->parent) {
+		up->count--;
+		up->weight -= node->weight;
+		if(up == bst->root)
+			break;
+	}
 
 	bst->size--;
 }
 
 /*
- * Returns the size of the BST by performing an in-order
- * traversal recursively.
+ * Links the sorted values in [lo, hi) into a balanced subtree using the nodes at
+ * the same positions in the block, and returns its root. The middle value of
+ * every range becomes the root of that range.
  */
-static int inorderSizeBST(BSTNODE *node) {
-	//Base case - size of the null node is 0
-	if(node == NULL)
-		return 0;
-	return 1 + inorderSizeBST(node->left) + inorderSizeBST(node->right);
+static BSTNODE *buildSubtree(BST *bst, BSTNODE *block, void **values, int lo, int hi,
+		int depth, int maxDepth, BSTNODE *parent, void (*placed)(BSTNODE *, int, int)) {
+	if(lo >= hi)
+		return NULL;
+	int mid = lo + (hi-lo)/2;
+	BSTNODE *node = &block[mid];
+	node->value = values[mid];
+	node->parent = parent == NULL ? node : parent;
+	node->left = buildSubtree(bst, block, values, lo, mid, depth+1, maxDepth, node, placed);
+	node->right = buildSubtree(bst, block, values, mid+1, hi, depth+1, maxDepth, node, placed);
+	updateBSTNODE(bst, node);
+	if(placed != NULL)
+		placed(node, depth, maxDepth);
+	return node;
 }
 /*
- * Returns the size of the bst. Should run in constant time except
- * when the root pointer has been forcibly updated. Then an
- * in order traversal must be performed to find the new size.
+ * Replaces the contents of an empty BST with the given values, which must
+ * already be in sorted order. Runs in linear time, builds a tree of minimum
+ * height, and allocates all of its nodes in a single block. The placed callback
+ * is given every node along with its depth, the root being at depth 0, and the
+ * depth of the deepest level.
  */
-int sizeBST(BST *bst) {
-	if(bst->size == -1)
-		bst->size = inorderSizeBST(bst->root);
-	return bst->size;
+void buildBST(BST *bst, void **values, int size, void (*placed)(BSTNODE *, int, int)) {
+	assert(bst->root == NULL);
+	if(size <= 0)
+		return;
+	int maxDepth = 0;
+	while((2LL << maxDepth) <= size)
+		maxDepth++;
+	BSTNODE *block = malloc(sizeof(BSTNODE) * size);
+	assert(block != 0);
+
+	bst->root = buildSubtree(bst, block, values, 0, size, 0, maxDepth, NULL, placed);
+	bst->first = &block[0];
+	bst->last = &block[size-1];
+	bst->size = size;
 }
 
 /*
- * Finds the smallest subtree by recursively moving down each level to find a leaf node.
- * Then comparing left and right trees when needed.
+ * Returns the size of the bst in constant time. When the root pointer has been
+ * forcibly updated the size has already been read back from the subtree count
+ * kept in the new root.
  */
-static int findSmallestSubtree(BSTNODE *node, int level) {
-	if(node == NULL)
-		return level;
-	int left = findSmallestSubtree(node->left, level+1);
-	int right = findSmallestSubtree(node->right, level+1);
-	if(left < right)
-		return left;
-	else
-		return right;
-}
-static int findLargestSubtree(BSTNODE *node, int level) {
-	if(node == NULL)
-		return level;
-	int left = findLargestSubtree(node->left, level+1);
-	int right = findLargestSubtree(node->right, level+1);
-	if(left > right)
-		return left;
-	else
-		return right;
+int sizeBST(BST *bst) {
+	return bst->size;
 }
+
 /*
- * Prints out the number of nodes, minumum depth, and maximum depth.
+ * Prints out the number of nodes, minimum depth, maximum depth and average depth.
+ * Depths count levels, so the root alone has a depth of 1, and the minimum depth
+ * is the shallowest level at which a node is missing a child.
+ * All of them are gathered in one walk that follows parent pointers instead of
+ * recursing, so a degenerate tree cannot overflow the stack.
  */
 void statisticsBST(FILE *fp, BST *bst) {
-	fprintf(fp, "Nodes: %d\n", sizeBST(bst));
-	fprintf(fp, "Minimum depth: %d\n", findSmallestSubtree(bst->root, 0));
-	fprintf(fp, "Maximum depth: %d\n", findLargestSubtree(bst->root, 0));
-}
+	int size = 0, minDepth = 0, maxDepth = 0, depth = 1;
+	long long depthSum = 0;
+	BSTNODE *node = bst->root, *last = NULL;
+	while(node != NULL) {
+		BSTNODE *next;
+		if(last == NULL || (node != bst->root && last == node->parent)) {
+			//First arrival at the node, coming down from its parent
+			size++;
+			depthSum += depth;
+			if(depth > maxDepth)
+				maxDepth = depth;
+			if((node->left == NULL || node->right == NULL) && (minDepth == 0 || depth < minDepth))
+				minDepth = depth;
+			next = node->left != NULL ? node->left : node->right;
+		} else if(last == node->left)
+			next = node->right;
+		else
+			next = NULL;
 
-/*
- * Wrapper for BSTNODE, also holds a level value stored as an int.
- */
-typedef struct bstnodemap {
-	BSTNODE *node;
-	int level;
-} nodeMap;
-/*
- * Creates the node map struct.
- */
-static nodeMap *newNodeMap(BSTNODE *node, int level) {
-	nodeMap *m = malloc(sizeof(nodeMap));
-	assert(m != 0);
+		last = node;
+		if(next != NULL) {
+			node = next;
+			depth++;
+		} else {
+			node = node == bst->root ? NULL : node->parent;
+			depth--;
+		}
+	}
 
-	m->node = node;
-	m->level = level;
-	return m;
+	fprintf(fp, "Nodes: %d\n", size);
+	fprintf(fp, "Minimum depth: %d\n", minDepth);
+	fprintf(fp, "Maximum depth: %d\n", maxDepth);
+	fprintf(fp, "Average depth: %.2f\n", size == 0 ? 0.0 : (double) depthSum / size);
 }
 
 /*
  * Displays all the nodes held in the BST in a breadth-first traversal.
- * Runs in linear time.
+ * Runs in linear time, even on a degenerate tree. The nodes waiting to be
+ * printed sit in a single array sized from the root's subtree count, and the
+ * end of each level is tracked as an index into it, so nothing is allocated per
+ * node. Everything apart from the values themselves is written
+ * with unformatted stdio calls.
  */
 void displayBST(FILE *fp, BST *bst) {
 	if(bst->root == NULL) {
-		fprintf(fp, "EMPTY\n");
+		fputs("EMPTY\n", fp);
 		return;
 	}
 
-	QUEUE *nodes = newQUEUE(NULL);
+	BSTNODE **nodes = malloc(sizeof(BSTNODE *) * getBSTNODEcount(bst->root));
+	assert(nodes != 0);
+	int head = 0, tail = 0, levelEnd = 1, level = 0;
+	nodes[tail++] = bst->root;
 
-	enqueue(nodes, newNodeMap(bst->root, 0));
-
-	fprintf(fp, "0: ");
-	while(sizeQUEUE(nodes) > 0) {
-		nodeMap *nodeM = dequeue(nodes);
-		BSTNODE *node = nodeM->node;
-		int level = nodeM->level;
+	fputs("0: ", fp);
+	while(head < tail) {
+		BSTNODE *node = nodes[head++];
 		//Check if node is leaf
 		if(node->left == NULL && node->right == NULL)
-			fprintf(fp, "=");
+			fputc('=', fp);
 		bst->display(fp, node->value);
-		fprintf(fp, "(");
+		fputc('(', fp);
 		if(node->parent == NULL)
 			bst->display(fp, node->value);
 		else
 			bst->display(fp, node->parent->value);
-		fprintf(fp, ")-");
+		fputs(")-", fp);
 
 		//Determine if node is root, left or right child
 		if(node == bst->root) {}
 		else if(node == node->parent->left)
-			fprintf(fp, "l");
+			fputc('l', fp);
 		else
-			fprintf(fp, "r");
+			fputc('r', fp);
 		//Add both its children to the queue
 		if(node->left != NULL)
-			enqueue(nodes, newNodeMap(node->left, level+1));
+			nodes[tail++] = node->left;
 		if(node->right != NULL)
-			enqueue(nodes, newNodeMap(node->right, level+1));
+			nodes[tail++] = node->right;
 
-		if(sizeQUEUE(nodes) > 0 && ((nodeMap *)peekQUEUE(nodes))->level > level)
-			fprintf(fp, "\n%d: ", level+1);
-		else if(sizeQUEUE(nodes) == 0)
-			fprintf(fp, "\n");
-		else
-			fprintf(fp, " ");
+		if(head == tail)
+			fputc('\n', fp);
+		else if(head == levelEnd) {
+			//Every node of the next level has been queued by now
+			level++;
+			levelEnd = tail;
+			fprintf(fp, "\n%d: ", level);
+		} else
+			fputc(' ', fp);
+	}
+	free(nodes);
+}
+
+/*
+ * In-order navigation. These follow the parent pointers already stored in each
+ * BSTNODE, so walking the whole tree needs no stack or queue and allocates
+ * nothing. A full walk from firstBST with nextBSTNODE is linear.
+ */
+static BSTNODE *leftmost(BSTNODE *node) {
+	while(node->left != NULL)
+		node = node->left;
+	return node;
+}
+static BSTNODE *rightmost(BSTNODE *node) {
+	while(node->right != NULL)
+		node = node->right;
+	return node;
+}
+/*
+ * The first and last nodes are cached, so these run in constant time. Rotations
+ * keep the in-order sequence of the nodes, so only insertBST, pruneLeafBST,
+ * buildBST and setBSTroot have to update them.
+ */
+BSTNODE *firstBST(BST *bst) {
+	return bst->first;
+}
+BSTNODE *lastBST(BST *bst) {
+	return bst->last;
+}
+/*
+ * Returns the in-order successor of the node, or NULL for the last node.
+ */
+BSTNODE *nextBSTNODE(BST *bst, BSTNODE *node) {
+	if(node->right != NULL)
+		return leftmost(node->right);
+	//The root is its own parent, so stop climbing there
+	while(node != bst->root && node == node->parent->right)
+		node = node->parent;
+	if(node == bst->root)
+		return NULL;
+	return node->parent;
+}
+/*
+ * Returns the in-order predecessor of the node, or NULL for the first node.
+ */
+BSTNODE *prevBSTNODE(BST *bst, BSTNODE *node) {
+	if(node->left != NULL)
+		return rightmost(node->left);
+	while(node != bst->root && node == node->parent->left)
+		node = node->parent;
+	if(node == bst->root)
+		return NULL;
+	return node->parent;
+}
+/*
+ * Returns the first node whose value is not less than the given value.
+ */
+BSTNODE *lowerBoundBST(BST *bst, void *value) {
+	BSTNODE *temp = bst->root, *best = NULL;
+	while(temp != NULL) {
+		if(bst->compare(value, temp->value) <= 0) {
+			best = temp;
+			temp = temp->left;
+		} else
+			temp = temp->right;
+	}
+	return best;
+}
+/*
+ * Returns the first node whose value is greater than the given value.
+ */
+BSTNODE *upperBoundBST(BST *bst, void *value) {
+	BSTNODE *temp = bst->root, *best = NULL;
+	while(temp != NULL) {
+		if(bst->compare(value, temp->value) < 0) {
+			best = temp;
+			temp = temp->left;
+		} else
+			temp = temp->right;
+	}
+	return best;
+}
+/*
+ * Returns the last node whose value is not greater than the given value.
+ */
+BSTNODE *floorBST(BST *bst, void *value) {
+	BSTNODE *temp = bst->root, *best = NULL;
+	while(temp != NULL) {
+		if(bst->compare(value, temp->value) >= 0) {
+			best = temp;
+			temp = temp->right;
+		} else
+			temp = temp->left;
+	}
+	return best;
+}
+/*
+ * Returns the first node whose value is not less than the given value.
+ */
+BSTNODE *ceilingBST(BST *bst, void *value) {
+	return lowerBoundBST(bst, value);
+}
+
+/*
+ * Order statistics. Each step down the tree skips a whole subtree using the counts
+ * or weights kept in the nodes, so these run in time proportional to the height.
+ */
+
+/*
+ * Returns the node holding the k-th smallest value, counting from 0, or NULL if k
+ * is out of range.
+ */
+BSTNODE *selectBST(BST *bst, int k) {
+	BSTNODE *temp = bst->root;
+	while(temp != NULL) {
+		int left = getBSTNODEcount(temp->left);
+		if(k < left)
+			temp = temp->left;
+		else if(k == left)
+			return temp;
+		else {
+			k -= left + 1;
+			temp = temp->right;
+		}
+	}
+	return NULL;
+}
+/*
+ * Returns the number of nodes whose values are less than the given value.
+ */
+int rankBST(BST *bst, void *value) {
+	BSTNODE *temp = bst->root;
+	int rank = 0;
+	while(temp != NULL) {
+		if(bst->compare(value, temp->value) <= 0)
+			temp = temp->left;
+		else {
+			rank += getBSTNODEcount(temp->left) + 1;
+			temp = temp->right;
+		}
+	}
+	return rank;
+}
+/*
+ * Returns the node covering position k, counting from 0, when every value is
+ * repeated as many times as its weight. Returns NULL if k is out of range.
+ */
+BSTNODE *selectBSTweighted(BST *bst, long long k) {
+	BSTNODE *temp = bst->root;
+	while(temp != NULL) {
+		long long left = getBSTNODEweight(temp->left);
+		long long own = ownWeight(bst, temp);
+		if(k < left)
+			temp = temp->left;
+		else if(k < left + own)
+			return temp;
+		else {
+			k -= left + own;
+			temp = temp->right;
+		}
+	}
+	return NULL;
+}
+/*
+ * Returns the total weight of the nodes whose values are less than the given value.
+ */
+long long rankBSTweighted(BST *bst, void *value) {
+	BSTNODE *temp = bst->root;
+	long long rank = 0;
+	while(temp != NULL) {
+		if(bst->compare(value, temp->value) <= 0)
+			temp = temp->left;
+		else {
+			rank += getBSTNODEweight(temp->left) + ownWeight(bst, temp);
+			temp = temp->right;
+		}
 	}
+	return rank;
 }
@@ -13,6 +13,8 @@ extern BSTNODE *getBSTNODEright(BSTNODE *n);
 extern void    setBSTNODEright(BSTNODE *n,BSTNODE *replacement);
 extern BSTNODE *getBSTNODEparent(BSTNODE *n);
 extern void    setBSTNODEparent(BSTNODE *n,BSTNODE *replacement);
+extern int     getBSTNODEcount(BSTNODE *n);
+extern long long getBSTNODEweight(BSTNODE *n);
 
 typedef struct bst BST;
 
@@ -20,14 +22,35 @@ extern BST *newBST(
 	void (*)(FILE *,void *),           //display
 	int (*)(void *,void *),            //comparator
 	void (*)(BSTNODE *,BSTNODE *));    //swapper
+extern void    setBSTweight(BST *t,long long (*)(void *));
 extern void    setBSTroot(BST *t,BSTNODE *replacement);
 extern BSTNODE *getBSTroot(BST *t);
 extern BSTNODE *insertBST(BST *t,void *value);
 extern BSTNODE *findBST(BST *t,void *value);
+extern void    findManyBST(BST *t,void **values,int size,BSTNODE **found);
+extern int     searchBST(BST *t,void *value,int steps,BSTNODE **found);
 extern BSTNODE *deleteBST(BST *t,void *value);
 extern BSTNODE *swapToLeafBST(BST *t,BSTNODE *node);
 extern void    pruneLeafBST(BST *t,BSTNODE *leaf);
+extern void    rotateLeftBST(BST *t,BSTNODE *n);
+extern void    rotateRightBST(BST *t,BSTNODE *n);
+extern void    updateBSTNODE(BST *t,BSTNODE *n);
+extern void    adjustBSTNODEweight(BST *t,BSTNODE *n,long long delta);
 extern int     sizeBST(BST *t);
 extern void    statisticsBST(FILE *fp,BST *t);
 extern void    displayBST(FILE *fp,BST *t);
+extern void    buildBST(BST *t,void **values,int size,
+	void (*)(BSTNODE *,int,int));      //placed(node,depth,maxDepth), may be NULL
+extern BSTNODE *firstBST(BST *t);
+extern BSTNODE *lastBST(BST *t);
+extern BSTNODE *nextBSTNODE(BST *t,BSTNODE *n);
+extern BSTNODE *prevBSTNODE(BST *t,BSTNODE *n);
+extern BSTNODE *lowerBoundBST(BST *t,void *value);
+extern BSTNODE *upperBoundBST(BST *t,void *value);
+extern BSTNODE *floorBST(BST *t,void *value);
+extern BSTNODE *ceilingBST(BST *t,void *value);
+extern BSTNODE *selectBST(BST *t,int k);
+extern int     rankBST(BST *t,void *value);
+extern BSTNODE *selectBSTweighted(BST *t,long long k);
+extern long long rankBSTweighted(BST *t,void *value);
 #endif
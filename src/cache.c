@@ -0,0 +1,355 @@
+#include "cache.h"
+#include "dll.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Contains the implementation for a fixed capacity cache that keeps its entries
+ * ordered in a DLL and indexes them with an open-addressing hash table. Every
+ * entry embeds its own DLLNODE, so a lookup, touch or eviction never walks the
+ * list.
+ *
+ * In LRU mode there is a single DLL of entries with the most recently used one
+ * at the front. In LFU mode the DLL holds buckets in increasing order of use
+ * count, and each bucket holds its own DLL of entries, most recently used first.
+ * Evictions take the least recently used entry of the lowest bucket.
+ *
+ * The entries, their list nodes and the LFU buckets all come from blocks made
+ * by newCACHE and are recycled through free lists, so gets, puts, touches and
+ * evictions never call malloc or free.
+ */
+
+typedef struct cachebucket BUCKET;
+typedef struct cacheentry {
+	void *key, *value;
+	unsigned hash;
+	DLLNODE node;
+	BUCKET *bucket;
+	struct cacheentry *nextFree;
+} ENTRY;
+struct cachebucket {
+	long freq;
+	DLL *entries;
+	DLLNODE node;
+	struct cachebucket *nextFree;
+};
+/*
+ * A slot of the hash index. The hash is kept next to the entry pointer so that
+ * probing only calls equals on a full hash match.
+ */
+typedef struct cacheslot {
+	unsigned hash;
+	ENTRY *entry;
+} SLOT;
+
+struct cache {
+	SLOT *slots;
+	unsigned mask;
+	ENTRY *entries, *freeEntries;
+	BUCKET *buckets, *freeBuckets;
+	DLL *order;
+	int policy, capacity, size;
+	long hits, misses;
+	unsigned (*hash)(void *);
+	int (*equals)(void *, void *);
+	void (*evict)(void *, void *);
+};
+
+CACHE *newCACHE(int capacity, int policy, unsigned (*h)(void *),
+		int (*e)(void *, void *), void (*ev)(void *, void *)) {
+	assert(capacity > 0);
+	assert(policy == CACHE_LRU || policy == CACHE_LFU);
+	CACHE *c = malloc(sizeof(CACHE));
+	assert(c != 0);
+
+	//The index is kept at most half full so probe sequences stay short
+	unsigned slots = 1;
+	while(slots < (unsigned) capacity * 2)
+		slots <<= 1;
+	c->slots = calloc(slots, sizeof(SLOT));
+	assert(c->slots != 0);
+	c->mask = slots - 1;
+
+	//Entries come from one block and are recycled through a free list
+	c->entries = malloc(sizeof(ENTRY) * capacity);
+	assert(c->entries != 0);
+	c->freeEntries = NULL;
+	for(int i=capacity-1; i>=0; i--) {
+		setDLLNODE(&c->entries[i].node, &c->entries[i]);
+		c->entries[i].nextFree = c->freeEntries;
+		c->freeEntries = &c->entries[i];
+	}
+
+	//Every bucket but the one a touch is moving into holds an entry, so LFU
+	//needs at most one bucket more than the capacity
+	c->buckets = NULL;
+	c->freeBuckets = NULL;
+	if(policy == CACHE_LFU) {
+		c->buckets = malloc(sizeof(BUCKET) * (capacity + 1));
+		assert(c->buckets != 0);
+		for(int i=capacity; i>=0; i--) {
+			c->buckets[i].entries = newDLL(NULL, NULL);
+			setDLLNODE(&c->buckets[i].node, &c->buckets[i]);
+			c->buckets[i].nextFree = c->freeBuckets;
+			c->freeBuckets = &c->buckets[i];
+		}
+	}
+
+	c->order = newDLL(NULL, NULL);
+	c->policy = policy;
+	c->capacity = capacity;
+	c->size = 0;
+	c->hits = 0;
+	c->misses = 0;
+	c->hash = h;
+	c->equals = e;
+	c->evict = ev;
+	return c;
+}
+
+/*
+ * Returns the slot holding the key, or -1 when it is not cached.
+ */
+static int findSlot(CACHE *c, void *key, unsigned hash) {
+	unsigned i = hash & c->mask;
+	while(c->slots[i].entry != NULL) {
+		if(c->slots[i].hash == hash && c->equals(key, c->slots[i].entry->key))
+			return i;
+		i = (i+1) & c->mask;
+	}
+	return -1;
+}
+static void insertSlot(CACHE *c, ENTRY *e) {
+	unsigned i = e->hash & c->mask;
+	while(c->slots[i].entry != NULL)
+		i = (i+1) & c->mask;
+	c->slots[i].hash = e->hash;
+	c->slots[i].entry = e;
+}
+/*
+ * Removes the entry from the index. Later slots of the probe run are shifted
+ * back so that no tombstones are needed.
+ */
+static void removeSlot(CACHE *c, ENTRY *e) {
+	unsigned i = e->hash & c->mask;
+	while(c->slots[i].entry != e)
+		i = (i+1) & c->mask;
+	unsigned j = i;
+	while(1) {
+		j = (j+1) & c->mask;
+		if(c->slots[j].entry == NULL)
+			break;
+		unsigned home = c->slots[j].hash & c->mask;
+		//The entry at j may fill the hole unless its home lies in (i, j]
+		if((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+			c->slots[i] = c->slots[j];
+			i = j;
+		}
+	}
+	c->slots[i].entry = NULL;
+}
+
+/*
+ * Takes a bucket from the pool for the given use count and links it after the
+ * given bucket node, or at the front of the order when after is NULL.
+ */
+static BUCKET *newBUCKET(CACHE *c, long freq, DLLNODE *after) {
+	BUCKET *b = c->freeBuckets;
+	assert(b != 0);
+	c->freeBuckets = b->nextFree;
+
+	b->freq = freq;
+	if(after == NULL)
+		linkDLLfront(c->order, &b->node);
+	else
+		linkDLLafter(c->order, after, &b->node);
+	return b;
+}
+/*
+ * Unlinks an empty bucket from the order and returns it to the pool.
+ */
+static void freeBUCKET(CACHE *c, BUCKET *b) {
+	unlinkDLLNODE(c->order, &b->node);
+	b->nextFree = c->freeBuckets;
+	c->freeBuckets = b;
+}
+
+/*
+ * Records a use of the entry. LRU moves it to the front of the order, LFU moves
+ * it to the bucket for the next use count.
+ */
+static void touchENTRY(CACHE *c, ENTRY *e) {
+	if(c->policy == CACHE_LRU) {
+		transferDLLNODE(c->order, c->order, &e->node);
+		return;
+	}
+	BUCKET *b = e->bucket, *next = NULL;
+	DLLNODE *n = nextDLLNODE(c->order, &b->node);
+	if(n != NULL && ((BUCKET *) getDLLNODE(n))->freq == b->freq+1)
+		next = getDLLNODE(n);
+	else
+		next = newBUCKET(c, b->freq+1, &b->node);
+	transferDLLNODE(next->entries, b->entries, &e->node);
+	e->bucket = next;
+	if(sizeDLL(b->entries) == 0)
+		freeBUCKET(c, b);
+}
+/*
+ * Unlinks the entry from the order and the index and returns it to the free list.
+ */
+static void removeENTRY(CACHE *c, ENTRY *e) {
+	removeSlot(c, e);
+	if(c->policy == CACHE_LRU)
+		unlinkDLLNODE(c->order, &e->node);
+	else {
+		unlinkDLLNODE(e->bucket->entries, &e->node);
+		if(sizeDLL(e->bucket->entries) == 0)
+			freeBUCKET(c, e->bucket);
+	}
+	e->nextFree = c->freeEntries;
+	c->freeEntries = e;
+	c->size--;
+}
+
+/*
+ * Returns the value cached for the key and records a use of it, or NULL on a miss.
+ */
+void *getCACHE(CACHE *c, void *key) {
+	int i = findSlot(c, key, c->hash(key));
+	if(i < 0) {
+		c->misses++;
+		return NULL;
+	}
+	c->hits++;
+	ENTRY *e = c->slots[i].entry;
+	touchENTRY(c, e);
+	return e->value;
+}
+/*
+ * Caches the value under the key, evicting an entry first if the cache is full.
+ * If the key was already cached its value is replaced and the old value is
+ * returned, otherwise NULL is returned.
+ */
+void *putCACHE(CACHE *c, void *key, void *value) {
+	unsigned hash = c->hash(key);
+	int i = findSlot(c, key, hash);
+	if(i >= 0) {
+		ENTRY *e = c->slots[i].entry;
+		void *old = e->value;
+		e->value = value;
+		touchENTRY(c, e);
+		return old;
+	}
+	if(c->size == c->capacity)
+		evictCACHE(c);
+
+	ENTRY *e = c->freeEntries;
+	c->freeEntries = e->nextFree;
+	e->key = key;
+	e->value = value;
+	e->hash = hash;
+	insertSlot(c, e);
+	if(c->policy == CACHE_LRU) {
+		e->bucket = NULL;
+		linkDLLfront(c->order, &e->node);
+	} else {
+		DLLNODE *first = headDLL(c->order);
+		if(first != NULL && ((BUCKET *) getDLLNODE(first))->freq == 1)
+			e->bucket = getDLLNODE(first);
+		else
+			e->bucket = newBUCKET(c, 1, NULL);
+		linkDLLfront(e->bucket->entries, &e->node);
+	}
+	c->size++;
+	return NULL;
+}
+/*
+ * Records a use of the key without counting a hit. Returns 1 if the key was
+ * cached and 0 otherwise.
+ */
+int touchCACHE(CACHE *c, void *key) {
+	int i = findSlot(c, key, c->hash(key));
+	if(i < 0)
+		return 0;
+	touchENTRY(c, c->slots[i].entry);
+	return 1;
+}
+/*
+ * Drops the key from the cache without calling the eviction callback. Returns
+ * its value, or NULL if it was not cached.
+ */
+void *removeCACHE(CACHE *c, void *key) {
+	int i = findSlot(c, key, c->hash(key));
+	if(i < 0)
+		return NULL;
+	ENTRY *e = c->slots[i].entry;
+	void *value = e->value;
+	removeENTRY(c, e);
+	return value;
+}
+/*
+ * Evicts the entry chosen by the cache's policy and passes it to the eviction
+ * callback. Returns 0 if the cache was empty.
+ */
+int evictCACHE(CACHE *c) {
+	if(c->size == 0)
+		return 0;
+	ENTRY *e;
+	if(c->policy == CACHE_LRU)
+		e = getDLLNODE(tailDLL(c->order));
+	else {
+		BUCKET *b = getDLLNODE(headDLL(c->order));
+		e = getDLLNODE(tailDLL(b->entries));
+	}
+	void *key = e->key, *value = e->value;
+	removeENTRY(c, e);
+	if(c->evict != NULL)
+		c->evict(key, value);
+	return 1;
+}
+int sizeCACHE(CACHE *c) {
+	return c->size;
+}
+int capacityCACHE(CACHE *c) {
+	return c->capacity;
+}
+long hitsCACHE(CACHE *c) {
+	return c->hits;
+}
+long missesCACHE(CACHE *c) {
+	return c->misses;
+}
+/*
+ * Prints out the fill level and the hit/miss counters.
+ */
+void statisticsCACHE(FILE *fp, CACHE *c) {
+	long lookups = c->hits + c->misses;
+	fprintf(fp, "Entries: %d/%d\n", c->size, c->capacity);
+	fprintf(fp, "Hits: %ld\n", c->hits);
+	fprintf(fp, "Misses: %ld\n", c->misses);
+	fprintf(fp, "Hit rate: %.2f%%\n", lookups == 0 ? 0.0 : 100.0 * c->hits / lookups);
+}
+/*
+ * Frees the cache without calling the eviction callback. Keys and values are
+ * still owned by the caller. The entries are unlinked first, since their list
+ * nodes live in the entry block rather than in the lists.
+ */
+void freeCACHE(CACHE *c) {
+	while(c->size > 0) {
+		ENTRY *e;
+		if(c->policy == CACHE_LRU)
+			e = getDLLNODE(headDLL(c->order));
+		else
+			e = getDLLNODE(headDLL(((BUCKET *) getDLLNODE(headDLL(c->order)))->entries));
+		removeENTRY(c, e);
+	}
+	freeDLL(c->order);
+	if(c->policy == CACHE_LFU) {
+		for(int i=0; i<=c->capacity; i++)
+			freeDLL(c->buckets[i].entries);
+		free(c->buckets);
+	}
+	free(c->entries);
+	free(c->slots);
+	free(c);
+}
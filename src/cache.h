@@ -0,0 +1,27 @@
+#ifndef __CACHE_INCLUDED__
+#define __CACHE_INCLUDED__
+
+#include <stdio.h>
+
+#define CACHE_LRU 0
+#define CACHE_LFU 1
+
+typedef struct cache CACHE;
+
+extern CACHE *newCACHE(int capacity,int policy,
+	unsigned (*)(void *),              //hash
+	int (*)(void *,void *),            //equals
+	void (*)(void *,void *));          //evict(key,value), may be NULL
+extern void *getCACHE(CACHE *c,void *key);
+extern void *putCACHE(CACHE *c,void *key,void *value);
+extern int  touchCACHE(CACHE *c,void *key);
+extern void *removeCACHE(CACHE *c,void *key);
+extern int  evictCACHE(CACHE *c);
+extern int  sizeCACHE(CACHE *c);
+extern int  capacityCACHE(CACHE *c);
+extern long hitsCACHE(CACHE *c);
+extern long missesCACHE(CACHE *c);
+extern void statisticsCACHE(FILE *fp,CACHE *c);
+extern void freeCACHE(CACHE *c);
+
+#endif
@@ -0,0 +1,160 @@
+#include "crbt.h"
+#include "rbt.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+/*
+ * Contains the implementation for a red-black tree that many threads can read
+ * while one thread at a time changes it. Writers take a mutex and bump a
+ * sequence counter before and after their change, so the counter is odd while a
+ * change is in progress. Readers take no lock at all: they note the counter,
+ * search the tree with searchRBT and accept the result only if the counter was
+ * even and has not moved since. Otherwise they search again.
+ *
+ * A reader may race with a rotation or a delete, so it can follow a stale link
+ * or compare against a value that is being swapped. This is safe because the BST
+ * publishes its links with release stores and the RBT never frees a node or an
+ * RBTVALUE once it is in the tree; a reader never touches freed memory, only
+ * memory holding a possibly outdated view. searchRBT gives up after MAX_STEPS
+ * links, which no search of a valid red-black tree of at most INT_MAX nodes
+ * needs, so a reader racing with many writes cannot loop.
+ *
+ * Values passed to deleteCRBT must stay valid for as long as a reader could
+ * still be comparing against them, so the caller should not free them while
+ * readers are running.
+ */
+
+#define MAX_STEPS 64
+#define SPINS 128
+
+#ifdef __GNUC__
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define COUNT(x) __atomic_fetch_add(&(x), 1, __ATOMIC_RELAXED)
+#else
+#define LOAD(x) (x)
+#define STORE(x, v) ((x) = (v))
+#define FENCE()
+#define COUNT(x) ((x)++)
+#endif
+
+struct crbt {
+	RBT *tree;
+	pthread_mutex_t writer;
+	unsigned long sequence;
+	long retries;
+	int size;               //copied from the tree by writers
+	long long words;
+};
+
+CRBT *newCRBT(void (*d)(FILE *, void *), int (*c)(void *, void *)) {
+	CRBT *t = malloc(sizeof(CRBT));
+	assert(t != 0);
+
+	t->tree = newRBT(d, c);
+	pthread_mutex_init(&t->writer, NULL);
+	t->sequence = 0;
+	t->retries = 0;
+	t->size = 0;
+	t->words = 0;
+	return t;
+}
+
+/*
+ * Writers hold the mutex for the whole change and leave the sequence odd while
+ * it is in progress. The fence keeps the tree's stores from moving above the
+ * first increment. The counts are copied out afterwards so that readers load
+ * them atomically, rather than reading the tree's plain fields while a writer
+ * may be updating them.
+ */
+static void beginWrite(CRBT *t) {
+	pthread_mutex_lock(&t->writer);
+	STORE(t->sequence, t->sequence + 1);
+	FENCE();
+}
+static void endWrite(CRBT *t) {
+	STORE(t->size, sizeRBT(t->tree));
+	STORE(t->words, wordsRBT(t->tree));
+	STORE(t->sequence, t->sequence + 1);
+	pthread_mutex_unlock(&t->writer);
+}
+/*
+ * Returns the sequence once no change is in progress. A reader that keeps seeing
+ * a change yields, since the writer may be waiting for its core.
+ */
+static unsigned long beginRead(CRBT *t) {
+	unsigned long sequence;
+	int spins = 0;
+	while((sequence = LOAD(t->sequence)) & 1)
+		if(++spins % SPINS == 0)
+			sched_yield();
+	return sequence;
+}
+/*
+ * Returns 1 if no change started since beginRead returned the given sequence.
+ * The fence keeps the reader's loads of the tree from moving below the check.
+ */
+static int endRead(CRBT *t, unsigned long sequence) {
+	FENCE();
+	if(LOAD(t->sequence) == sequence)
+		return 1;
+	COUNT(t->retries);
+	return 0;
+}
+
+void insertCRBT(CRBT *t, void *value) {
+	beginWrite(t);
+	insertRBT(t->tree, value);
+	endWrite(t);
+}
+/*
+ * Returns the frequency of the value without blocking, retrying while writers
+ * change the tree underneath the search.
+ */
+long long findCRBT(CRBT *t, void *value) {
+	while(1) {
+		unsigned long sequence = beginRead(t);
+		long long freq = searchRBT(t->tree, value, MAX_STEPS);
+		if(endRead(t, sequence) && freq >= 0)
+			return freq;
+	}
+}
+/*
+ * Returns 0 if the value was not in the tree.
+ */
+int deleteCRBT(CRBT *t, void *value) {
+	beginWrite(t);
+	int deleted = deleteRBT(t->tree, value);
+	endWrite(t);
+	return deleted;
+}
+int sizeCRBT(CRBT *t) {
+	return LOAD(t->size);
+}
+long long wordsCRBT(CRBT *t) {
+	return LOAD(t->words);
+}
+/*
+ * Statistics and display walk the whole tree, so they hold off writers instead
+ * of retrying.
+ */
+void statisticsCRBT(FILE *fp, CRBT *t) {
+	pthread_mutex_lock(&t->writer);
+	statisticsRBT(fp, t->tree);
+	fprintf(fp, "Read retries: %ld\n", LOAD(t->retries));
+	pthread_mutex_unlock(&t->writer);
+}
+void displayCRBT(FILE *fp, CRBT *t) {
+	pthread_mutex_lock(&t->writer);
+	displayRBT(fp, t->tree);
+	pthread_mutex_unlock(&t->writer);
+}
+/*
+ * Returns how many reads had to be repeated because a write overlapped them.
+ */
+long retriesCRBT(CRBT *t) {
+	return LOAD(t->retries);
+}
@@ -0,0 +1,21 @@
+#ifndef __CRBT_INCLUDED__
+#define __CRBT_INCLUDED__
+
+#include <stdio.h>
+#include "rbt.h"
+
+typedef struct crbt CRBT;
+
+extern CRBT *newCRBT(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *));           //comparator
+extern void insertCRBT(CRBT *,void *);
+extern long long findCRBT(CRBT *,void *);
+extern int deleteCRBT(CRBT *,void *);
+extern int sizeCRBT(CRBT *);
+extern long long wordsCRBT(CRBT *);
+extern void statisticsCRBT(FILE *,CRBT *);
+extern void displayCRBT(FILE *,CRBT *);
+extern long retriesCRBT(CRBT *);
+
+#endif
@@ -3,12 +3,8 @@
 #include <assert.h>
 #include "dll.h"
 
-typedef struct node NODE;
-struct node {
-    NODE *next, *prev;
-    void *value;
-};
-NODE *newNODE(void *v) {
+typedef struct dllnode NODE;
+static NODE *newNODE(void *v) {
     NODE *n = malloc(sizeof(NODE));
     assert(n != 0);
 
@@ -110,11 +106,13 @@ void unionDLL(DLL *recipient, DLL *donor) {
         recipient->head->prev = donor->tail;
         donor->tail->next = recipient->head;
         recipient->size += donor->size;
-        freeDLL(donor);
+        recipient->tail = donor->tail;
+        free(donor);    //Its nodes now belong to the recipient
     } else if(recipient->size == 0 && donor->size != 0) {
-        DLL *temp = recipient;
-        recipient = donor;
-        free(temp);
+        recipient->head = donor->head;
+        recipient->tail = donor->tail;
+        recipient->size = donor->size;
+        free(donor);
     } else {    //When donor list is empty
         free(donor);    //Nothing to be done except free donor list
     }
@@ -179,13 +177,158 @@ void displayDLL(DLL *items, FILE *fp) {
             fprintf(fp, ",");
     }
 }
+/*
+ * Frees the list and its nodes, passing each value to the free function if one
+ * was given. Nodes linked in with the linkDLL calls belong to the caller, so
+ * they must be unlinked first.
+ */
 void freeDLL(DLL *items) {
-    NODE *item = items->head, *next = item->next;
+    NODE *item = items->head;
     for(int i=0; i<items->size; i++) {
-        items->free(item->value);
+        NODE *next = item->next;
+        if(items->free != NULL)
+            items->free(item->value);
         free(item);
         item = next;
-        if(next)
-            next = next->next;
     }
+    free(items);
+}
+
+/*
+ * Node handles let callers hold on to a position in the list so that it can be
+ * unlinked or moved later in constant time, instead of walking to an index.
+ */
+void *getDLLNODE(DLLNODE *n) {
+    assert(n != 0);
+    return n->value;
+}
+void setDLLNODE(DLLNODE *n, void *value) {
+    assert(n != 0);
+    n->value = value;
+}
+
+/*
+ * Links an unattached node in between left and right. Both are NULL when the
+ * list is empty.
+ */
+static void linkNODE(DLL *items, NODE *left, NODE *right, NODE *item) {
+    if(items->size == 0) {
+        item->next = item;
+        item->prev = item;
+        items->head = item;
+        items->tail = item;
+    } else {
+        left->next = item;
+        right->prev = item;
+        item->next = right;
+        item->prev = left;
+    }
+    items->size++;
+}
+/*
+ * Detaches the node from the list without freeing it.
+ */
+static void unlinkNODE(DLL *items, NODE *item) {
+    if(items->size == 1) {
+        items->head = NULL;
+        items->tail = NULL;
+    } else {
+        item->prev->next = item->next;
+        item->next->prev = item->prev;
+        if(item == items->head)
+            items->head = item->next;
+        if(item == items->tail)
+            items->tail = item->prev;
+    }
+    item->next = NULL;
+    item->prev = NULL;
+    items->size--;
+}
+DLLNODE *insertDLLfront(DLL *items, void *value) {
+    NODE *item = newNODE(value);
+    linkNODE(items, items->tail, items->head, item);
+    items->head = item;
+    return item;
+}
+DLLNODE *insertDLLback(DLL *items, void *value) {
+    NODE *item = newNODE(value);
+    linkNODE(items, items->tail, items->head, item);
+    items->tail = item;
+    return item;
+}
+DLLNODE *insertDLLafter(DLL *items, DLLNODE *n, void *value) {
+    assert(n != 0);
+    NODE *item = newNODE(value);
+    linkNODE(items, n, n->next, item);
+    if(n == items->tail)
+        items->tail = item;
+    return item;
+}
+/*
+ * Links a caller-owned node that is on no list at the front of the list, or after
+ * the given node. Neither allocates; the value is whatever setDLLNODE last put
+ * in the node.
+ */
+void linkDLLfront(DLL *items, DLLNODE *n) {
+    assert(n != 0);
+    linkNODE(items, items->tail, items->head, n);
+    items->head = n;
+}
+void linkDLLafter(DLL *items, DLLNODE *after, DLLNODE *n) {
+    assert(after != 0 && n != 0);
+    linkNODE(items, after, after->next, n);
+    if(after == items->tail)
+        items->tail = n;
+}
+/*
+ * Detaches the node from the list in constant time without freeing it, so that
+ * a caller-owned node can be linked in again later.
+ */
+void unlinkDLLNODE(DLL *items, DLLNODE *n) {
+    assert(items->size > 0 && n != 0);
+    unlinkNODE(items, n);
+}
+/*
+ * Removes the given node from the list in constant time and returns its value.
+ */
+void *removeDLLNODE(DLL *items, DLLNODE *n) {
+    assert(items->size > 0 && n != 0);
+    unlinkNODE(items, n);
+    void *temp = n->value;
+    free(n);
+    return temp;
+}
+/*
+ * Moves the node from the donor list to the front of the recipient list without
+ * reallocating it. The two lists may be the same.
+ */
+void transferDLLNODE(DLL *recipient, DLL *donor, DLLNODE *n) {
+    assert(donor->size > 0 && n != 0);
+    if(recipient == donor && n == recipient->head)
+        return;
+    unlinkNODE(donor, n);
+    linkNODE(recipient, recipient->tail, recipient->head, n);
+    recipient->head = n;
+}
+DLLNODE *headDLL(DLL *items) {
+    return items->head;
+}
+DLLNODE *tailDLL(DLL *items) {
+    return items->tail;
+}
+/*
+ * Returns the node after n, or NULL when n is the tail.
+ */
+DLLNODE *nextDLLNODE(DLL *items, DLLNODE *n) {
+    if(n == items->tail)
+        return NULL;
+    return n->next;
+}
+/*
+ * Returns the node before n, or NULL when n is the head.
+ */
+DLLNODE *prevDLLNODE(DLL *items, DLLNODE *n) {
+    if(n == items->head)
+        return NULL;
+    return n->prev;
 }
@@ -3,6 +3,21 @@
 
 #include <stdio.h>
 
+typedef struct dllnode DLLNODE;
+
+/*
+ * The node is visible so that callers can embed it in their own structs and
+ * link it with the linkDLL calls, which never allocate. Its fields belong to the
+ * list it is on.
+ */
+struct dllnode {
+    DLLNODE *next, *prev;
+    void *value;
+};
+
+extern void    *getDLLNODE(DLLNODE *n);
+extern void    setDLLNODE(DLLNODE *n,void *value);
+
 typedef struct dll DLL;
 
 extern DLL *newDLL(void (*d)(void *,FILE *),void (*f)(void *)); 
@@ -15,5 +30,17 @@ extern int findDLL(DLL *items, void *value);
 extern int sizeDLL(DLL *items);
 extern void displayDLL(DLL *items,FILE *);
 extern void freeDLL(DLL *items);
+extern DLLNODE *insertDLLfront(DLL *items,void *value);
+extern DLLNODE *insertDLLback(DLL *items,void *value);
+extern DLLNODE *insertDLLafter(DLL *items,DLLNODE *n,void *value);
+extern void *removeDLLNODE(DLL *items,DLLNODE *n);
+extern void transferDLLNODE(DLL *recipient,DLL *donor,DLLNODE *n);
+extern void linkDLLfront(DLL *items,DLLNODE *n);
+extern void linkDLLafter(DLL *items,DLLNODE *after,DLLNODE *n);
+extern void unlinkDLLNODE(DLL *items,DLLNODE *n);
+extern DLLNODE *headDLL(DLL *items);
+extern DLLNODE *tailDLL(DLL *items);
+extern DLLNODE *nextDLLNODE(DLL *items,DLLNODE *n);
+extern DLLNODE *prevDLLNODE(DLL *items,DLLNODE *n);
 
 #endif
@@ -0,0 +1,170 @@
+#include "frozen.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Contains the implementation for a frozen, read-only search structure built
+ * from the sorted contents of a tree. The values are laid out in Eytzinger
+ * (breadth-first) order, so the first levels of every search share a handful of
+ * cache lines and the next levels can be prefetched before they are needed.
+ * The search loop has no data-dependent branch apart from the comparator call.
+ * Sorted copies of the values, frequencies and their running totals answer
+ * rank and range queries once the search has found a position.
+ */
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+struct frozen {
+	void (*display)(FILE *, void *);
+	int (*compare)(void *, void *);
+	int size;
+	void **layout;          //values in Eytzinger order, starting at index 1
+	int *position;          //sorted position of each layout slot
+	void **values;          //values in sorted order
+	long long *freqs;
+	long long *totals;      //totals[i] is the sum of freqs[0..i-1]
+};
+
+/*
+ * Fills the layout with an in-order walk of the implicit tree rooted at slot k.
+ */
+static int layoutFROZEN(FROZEN *f, int k, int next) {
+	if(k > f->size)
+		return next;
+	next = layoutFROZEN(f, 2*k, next);
+	f->layout[k] = f->values[next];
+	f->position[k] = next;
+	next++;
+	return layoutFROZEN(f, 2*k+1, next);
+}
+/*
+ * Creates a frozen structure from values that are already sorted and distinct.
+ * freqs may be NULL, in which case every value counts once. The arrays are copied.
+ */
+FROZEN *newFROZEN(void (*d)(FILE *, void *), int (*c)(void *, void *),
+		void **values, long long *freqs, int size) {
+	FROZEN *f = malloc(sizeof(FROZEN));
+	assert(f != 0);
+
+	f->display = d;
+	f->compare = c;
+	f->size = size;
+	f->layout = malloc(sizeof(void *) * (size+1));
+	f->position = malloc(sizeof(int) * (size+1));
+	f->values = malloc(sizeof(void *) * (size+1));
+	f->freqs = malloc(sizeof(long long) * (size+1));
+	f->totals = malloc(sizeof(long long) * (size+1));
+	assert(f->layout != 0 && f->position != 0 && f->values != 0);
+	assert(f->freqs != 0 && f->totals != 0);
+
+	f->totals[0] = 0;
+	for(int i=0; i<size; i++) {
+		assert(i == 0 || c(values[i-1], values[i]) < 0);
+		f->values[i] = values[i];
+		f->freqs[i] = freqs == NULL ? 1 : freqs[i];
+		f->totals[i+1] = f->totals[i] + f->freqs[i];
+	}
+	layoutFROZEN(f, 1, 0);
+	return f;
+}
+
+/*
+ * Returns the sorted position of the first value not less than the given value,
+ * or the size when every value is less.
+ */
+static int lowerBoundFROZEN(FROZEN *f, void *value) {
+	int k = 1;
+	while(k <= f->size) {
+		//The slots four levels down share one or two cache lines
+		PREFETCH(f->layout + 16*k);
+		k = 2*k + (f->compare(f->layout[k], value) < 0);
+	}
+	//Undo the right turns taken after the last left turn, and that left turn
+	while(k & 1)
+		k >>= 1;
+	k >>= 1;
+	return k == 0 ? f->size : f->position[k];
+}
+/*
+ * Returns the frequency of the value, or 0 if it is not present.
+ */
+long long findFROZEN(FROZEN *f, void *value) {
+	int i = lowerBoundFROZEN(f, value);
+	if(i < f->size && f->compare(f->values[i], value) == 0)
+		return f->freqs[i];
+	return 0;
+}
+/*
+ * Returns the number of distinct values less than the given value.
+ */
+int rankFROZEN(FROZEN *f, void *value) {
+	return lowerBoundFROZEN(f, value);
+}
+/*
+ * Returns the sum of the frequencies of the values less than the given value.
+ */
+long long rankFROZENweighted(FROZEN *f, void *value) {
+	return f->totals[lowerBoundFROZEN(f, value)];
+}
+/*
+ * Returns the k-th smallest value, counting from 0, or NULL if k is out of range.
+ */
+void *selectFROZEN(FROZEN *f, int k) {
+	if(k < 0 || k >= f->size)
+		return NULL;
+	return f->values[k];
+}
+/*
+ * Visits every value in [lo, hi] in order, passing its frequency along.
+ */
+void rangeFROZEN(FROZEN *f, void *lo, void *hi, void (*visit)(void *, long long, void *), void *arg) {
+	for(int i=lowerBoundFROZEN(f, lo); i<f->size; i++) {
+		if(f->compare(f->values[i], hi) > 0)
+			break;
+		visit(f->values[i], f->freqs[i], arg);
+	}
+}
+int sizeFROZEN(FROZEN *f) {
+	return f->size;
+}
+long long wordsFROZEN(FROZEN *f) {
+	return f->totals[f->size];
+}
+void statisticsFROZEN(FILE *fp, FROZEN *f) {
+	int depth = 0;
+	while((1LL << depth) <= f->size)
+		depth++;
+	fprintf(fp, "Words/Phrases: %lld\n", wordsFROZEN(f));
+	fprintf(fp, "Nodes: %d\n", f->size);
+	fprintf(fp, "Search depth: %d\n", depth);
+}
+/*
+ * Prints out the values in sorted order, each followed by its frequency when
+ * that is greater than 1.
+ */
+void displayFROZEN(FILE *fp, FROZEN *f) {
+	fputc('[', fp);
+	for(int i=0; i<f->size; i++) {
+		if(i > 0)
+			fputc(',', fp);
+		f->display(fp, f->values[i]);
+		if(f->freqs[i] > 1)
+			fprintf(fp, "-%lld", f->freqs[i]);
+	}
+	fputs("]\n", fp);
+}
+/*
+ * Frees the structure. The values themselves are still owned by the caller.
+ */
+void freeFROZEN(FROZEN *f) {
+	free(f->layout);
+	free(f->position);
+	free(f->values);
+	free(f->freqs);
+	free(f->totals);
+	free(f);
+}
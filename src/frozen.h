@@ -0,0 +1,25 @@
+#ifndef __FROZEN_INCLUDED__
+#define __FROZEN_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct frozen FROZEN;
+
+extern FROZEN *newFROZEN(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	void **values,long long *freqs,int size);
+extern long long findFROZEN(FROZEN *f,void *value);
+extern int  rankFROZEN(FROZEN *f,void *value);
+extern long long rankFROZENweighted(FROZEN *f,void *value);
+extern void *selectFROZEN(FROZEN *f,int k);
+extern void rangeFROZEN(FROZEN *f,void *lo,void *hi,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern int  sizeFROZEN(FROZEN *f);
+extern long long wordsFROZEN(FROZEN *f);
+extern void statisticsFROZEN(FILE *fp,FROZEN *f);
+extern void displayFROZEN(FILE *fp,FROZEN *f);
+extern void freeFROZEN(FROZEN *f);
+
+#endif
@@ -1,8 +1,14 @@
 #include "gt.h"
 #include "bst.h"
+#include "da.h"
+#include "sort.h"
+#include "frozen.h"
+#include "snapshot.h"
+#include "bloom.h"
 #include <assert.h>
 #include <stdlib.h>
 //#include "string.h"//TODO remove
+#define FILTER_MINIMUM 1024
 
 /*
  * Written by Zach Wassynger on October 19th, 2017. Contains the implementation
@@ -13,103 +19,916 @@
 
 typedef struct gtvalue {
 	void *value;
-	int freq;
+	long long freq;
+	int rank;               //position in the top-K heaps, or -1
+	unsigned long long prefix;
 	void (*display)(FILE *,void *);
 	int (*compare)(void *,void *);
 } GTVALUE;
-static GTVALUE *newGTVALUE(void *value,
-		void (*d)(FILE *,void *), int (*c)(void *,void *)) {
+static GTVALUE keyGTVALUE(GT *gt, void *value);
+static GTVALUE *newGTVALUE(GT *gt, void *value) {
 	GTVALUE *p = malloc(sizeof(GTVALUE));
 	assert(p != 0);
 
-	p->value = value;
+	*p = keyGTVALUE(gt, value);
 	p->freq = 1;
-	p->display = d;
-	p->compare = c;
 	return p;
 }
 
+typedef struct gttop {
+	GTVALUE **items;        //a min-heap under worseTop
+	GTVALUE **rest;         //a max-heap of every other value, when tracked
+	int size, capacity, restSize, restCapacity, tracked;
+} TOPK;
+
 struct gt {
 	BST *tree;
-	int numWords;
+	long long numWords;
 	void (*display)(FILE *,void *);
 	int (*compare)(void *,void *);
+	unsigned long long (*prefix)(void *);
+	BLOOM *filter;
+	unsigned (*hash)(void *);
+	int bitsPerKey, stale;
+	long long filtered, falsePositives;
+	TOPK top;
 };
 
 static void displayGTVALUE(FILE *fp, void *value);
 static int compareGTVALUE(void *x, void *y);
+static void addGT(GT *gt, void *value, long long freq);
+static void rebuildFilter(GT *gt);
+static void addFilter(GT *gt, void *value);
+static long long removeGT(GT *gt, BSTNODE *node, long long count);
+static long long weighGTVALUE(void *value);
+static void enterTop(TOPK *h, GTVALUE *value);
+static void moveTop(TOPK *h, GTVALUE *value);
+static void leaveTop(TOPK *h, GTVALUE *value);
+static void trackTop(GT *gt);
 
 GT *newGT(void (*d)(FILE *,void *),int (*c)(void *,void *)) {
 	GT *p = malloc(sizeof(GT));
 	assert(p != 0);
 
 	p->tree = newBST(displayGTVALUE, compareGTVALUE, NULL);
+	setBSTweight(p->tree, weighGTVALUE);
 	p->numWords = 0;
 	p->display = d;
 	p->compare = c;
+	p->prefix = NULL;
+	p->filter = NULL;
+	p->hash = NULL;
+	p->bitsPerKey = 0;
+	p->stale = 0;
+	p->filtered = 0;
+	p->falsePositives = 0;
+	p->top.items = NULL;
+	p->top.rest = NULL;
+	p->top.size = 0;
+	p->top.capacity = 0;
+	p->top.restSize = 0;
+	p->top.restCapacity = 0;
+	p->top.tracked = 1;
 	return p;
 }
-void insertGT(GT *gt, void *value) {
-	GTVALUE *v = newGTVALUE(value, gt->display, gt->compare);
-	BSTNODE *node = findBST(gt->tree, v);
-	if(node == NULL)
-		node = insertBST(gt->tree, v);
+/*
+ * Turns on key-prefix caching, as setRBTprefix does for the RBT. May likewise be
+ * called on a tree that already holds values.
+ */
+void setGTprefix(GT *gt, unsigned long long (*prefix)(void *)) {
+	gt->prefix = prefix;
+	for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node)) {
+		GTVALUE *value = getBSTNODE(node);
+		value->prefix = prefix == NULL ? 0 : prefix(value->value);
+	}
+}
+/*
+ * Creates a green tree from values that are already in sorted order. freqs may
+ * be NULL, in which case every value counts once. Runs of equal values are
+ * merged into one node holding the sum of their frequencies. The tree is built
+ * balanced in linear time, with its nodes and GTVALUEs allocated in one block each.
+ */
+GT *buildGTfromSorted(void (*d)(FILE *,void *), int (*c)(void *,void *),
+		void **values, long long *freqs, int size) {
+	GT *gt = newGT(d, c);
+	if(size <= 0)
+		return gt;
+	GTVALUE *block = malloc(sizeof(GTVALUE) * size);
+	void **wrapped = malloc(sizeof(void *) * size);
+	assert(block != 0 && wrapped != 0);
+
+	int count = 0;
+	for(int i=0; i<size; i++) {
+		long long freq = freqs == NULL ? 1 : freqs[i];
+		if(count > 0 && c(block[count-1].value, values[i]) == 0)
+			block[count-1].freq += freq;
+		else {
+			assert(count == 0 || c(block[count-1].value, values[i]) < 0);
+			block[count] = keyGTVALUE(gt, values[i]);
+			block[count].freq = freq;
+			wrapped[count] = &block[count];
+			count++;
+		}
+		gt->numWords += freq;
+	}
+	buildBST(gt->tree, wrapped, count, NULL);
+	free(wrapped);
+	return gt;
+}
+/*
+ * Creates a green tree from the values held in the DA. If threads is positive the
+ * values are sorted first, using up to that many threads. Otherwise they must
+ * already be in sorted order. The DA is left unchanged.
+ */
+GT *buildGTfromDA(void (*d)(FILE *,void *), int (*c)(void *,void *), DA *values, int threads) {
+	int size = sizeDA(values);
+	void **sorted = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	assert(sorted != 0);
+	for(int i=0; i<size; i++)
+		sorted[i] = getDA(values, i);
+	if(threads > 0)
+		sortValues(sorted, NULL, size, c, threads);
+	GT *gt = buildGTfromSorted(d, c, sorted, NULL, size);
+	free(sorted);
+	return gt;
+}
+/*
+ * Creates a balanced tree holding the values of both trees, with the
+ * frequencies of values found in both added together. Walks the two trees in
+ * order side by side and builds the result directly, so it runs in O(n + m).
+ * Both trees are left unchanged and must use the same comparator.
+ */
+GT *mergeGT(GT *a, GT *b) {
+	int size = sizeGT(a) + sizeGT(b);
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+
+	BSTNODE *x = firstGT(a), *y = firstGT(b);
+	int count = 0;
+	while(x != NULL || y != NULL) {
+		int comparison;
+		if(x == NULL)
+			comparison = 1;
+		else if(y == NULL)
+			comparison = -1;
+		else
+			comparison = a->compare(getGTNODEvalue(x), getGTNODEvalue(y));
+		if(comparison <= 0) {
+			values[count] = getGTNODEvalue(x);
+			freqs[count] = getGTNODEfreq(x);
+			if(comparison == 0) {
+				freqs[count] += getGTNODEfreq(y);
+				y = nextGT(b, y);
+			}
+			x = nextGT(a, x);
+		} else {
+			values[count] = getGTNODEvalue(y);
+			freqs[count] = getGTNODEfreq(y);
+			y = nextGT(b, y);
+		}
+		count++;
+	}
+	GT *merged = buildGTfromSorted(a->display, a->compare, values, freqs, count);
+	free(values);
+	free(freqs);
+	return merged;
+}
+/*
+ * Adds every value of the donor, with its frequency, into the recipient. Costs
+ * O(m log(n + m)) for a donor of m values, which beats mergeGT when the donor is
+ * much smaller than the recipient. The donor is left unchanged.
+ */
+void absorbGT(GT *recipient, GT *donor) {
+	for(BSTNODE *node = firstGT(donor); node != NULL; node = nextGT(donor, node))
+		addGT(recipient, getGTNODEvalue(node), getGTNODEfreq(node));
+}
+/*
+ * Turns on a Bloom filter in front of the tree, as setRBTfilter does for the
+ * RBT. Passing a bitsPerKey of 0 turns it off.
+ */
+void setGTfilter(GT *gt, unsigned (*hash)(void *), int bitsPerKey) {
+	if(gt->filter != NULL)
+		freeBLOOM(gt->filter);
+	gt->filter = NULL;
+	gt->hash = hash;
+	gt->bitsPerKey = bitsPerKey;
+	gt->filtered = 0;
+	gt->falsePositives = 0;
+	if(bitsPerKey > 0)
+		rebuildFilter(gt);
+}
+static void rebuildFilter(GT *gt) {
+	int capacity = 2 * sizeGT(gt);
+	if(capacity < FILTER_MINIMUM)
+		capacity = FILTER_MINIMUM;
+	if(gt->filter == NULL || capacityBLOOM(gt->filter) != capacity) {
+		if(gt->filter != NULL)
+			freeBLOOM(gt->filter);
+		gt->filter = newBLOOM(capacity, gt->bitsPerKey);
+	} else
+		clearBLOOM(gt->filter);
+	for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node))
+		addBLOOM(gt->filter, gt->hash(getGTNODEvalue(node)));
+	gt->stale = 0;
+}
+static void addFilter(GT *gt, void *value) {
+	if(gt->filter == NULL)
+		return;
+	if(keysBLOOM(gt->filter) < capacityBLOOM(gt->filter))
+		addBLOOM(gt->filter, gt->hash(value));
+	else
+		rebuildFilter(gt);
+}
+/*
+ * Returns 0 if the filter rules the value out.
+ */
+static int passFilter(GT *gt, void *value) {
+	if(gt->filter == NULL || checkBLOOM(gt->filter, gt->hash(value)))
+		return 1;
+	gt->filtered++;
+	return 0;
+}
+/*
+ * Adds freq occurrences of the value, creating its node if it is new.
+ */
+static void addGT(GT *gt, void *value, long long freq) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	BSTNODE *node = findBST(gt->tree, &key);
+	GTVALUE *v;
+	if(node == NULL) {
+		v = newGTVALUE(gt, value);
+		v->freq = freq;
+		insertBST(gt->tree, v);
+		addFilter(gt, value);
+		if(gt->top.items != NULL)
+			enterTop(&gt->top, v);
+	}
 	else {
 		v = getBSTNODE(node);
-		v->freq++;
+		v->freq += freq;
+		adjustBSTNODEweight(gt->tree, node, freq);
+		if(gt->top.items != NULL)
+			moveTop(&gt->top, v);
 	}
-	gt->numWords++;
+	gt->numWords += freq;
 }
-int findGT(GT *gt, void *v) {
-	BSTNODE *node = findBST(gt->tree, newGTVALUE(v, gt->display, gt->compare));
-	if(node == NULL)
+void insertGT(GT *gt, void *value) {
+	addGT(gt, value, 1);
+}
+/*
+ * Adds count occurrences of the value at once.
+ */
+void insertGTcount(GT *gt, void *value, long long count) {
+	assert(count > 0);
+	addGT(gt, value, count);
+}
+/*
+ * Inserts the sorted new values in [lo, hi) middle first, so that those landing
+ * between the same two nodes of the tree form a balanced subtree there rather
+ * than a chain.
+ */
+static void insertMiddleFirst(GT *gt, void **added, int lo, int hi) {
+	if(lo >= hi)
+		return;
+	int mid = lo + (hi-lo)/2;
+	insertBST(gt->tree, added[mid]);
+	addFilter(gt, ((GTVALUE *) added[mid])->value);
+	insertMiddleFirst(gt, added, lo, mid);
+	insertMiddleFirst(gt, added, mid+1, hi);
+}
+/*
+ * Copies the GTVALUEs that wrapped points to into a block of their own, sized to
+ * them, and points wrapped at the copies, as keepRBTVALUEs does.
+ */
+static void keepGTVALUEs(void **wrapped, int count) {
+	if(count == 0)
+		return;
+	GTVALUE *kept = malloc(sizeof(GTVALUE) * count);
+	assert(kept != 0);
+	for(int i=0; i<count; i++) {
+		kept[i] = *(GTVALUE *) wrapped[i];
+		wrapped[i] = &kept[i];
+	}
+}
+/*
+ * Adds counts[i] occurrences of values[i] for every i in one ordered pass, as
+ * insertManyRBT does. counts may be NULL, in which case every value counts once,
+ * and entries with a count of 0 are skipped. New values are inserted middle
+ * first, and an empty tree is built balanced in linear time.
+ */
+void insertManyGT(GT *gt, void **values, long long *counts, int size, int threads) {
+	int n = size > 0 ? size : 1;
+	GTVALUE *block = malloc(sizeof(GTVALUE) * n);
+	void **wrapped = malloc(sizeof(void *) * n);
+	assert(block != 0 && wrapped != 0);
+
+	int kept = 0;
+	for(int i=0; i<size; i++) {
+		long long count = counts == NULL ? 1 : counts[i];
+		assert(count >= 0);
+		if(count == 0)
+			continue;
+		block[kept] = keyGTVALUE(gt, values[i]);
+		block[kept].freq = count;
+		wrapped[kept] = &block[kept];
+		kept++;
+	}
+	sortValues(wrapped, NULL, kept, compareGTVALUE, threads > 0 ? threads : 1);
+	int distinct = 0;
+	for(int i=0; i<kept; i++) {
+		GTVALUE *v = wrapped[i];
+		gt->numWords += v->freq;
+		if(distinct > 0 && compareGTVALUE(wrapped[distinct-1], v) == 0)
+			((GTVALUE *) wrapped[distinct-1])->freq += v->freq;
+		else
+			wrapped[distinct++] = v;
+	}
+
+	if(sizeGT(gt) == 0) {
+		keepGTVALUEs(wrapped, distinct);
+		buildBST(gt->tree, wrapped, distinct, NULL);
+		if(gt->filter != NULL)
+			rebuildFilter(gt);
+		if(gt->top.items != NULL)
+			trackTop(gt);
+	} else {
+		int inserted = 0;
+		BSTNODE **found = malloc(sizeof(BSTNODE *) * n);
+		assert(found != 0);
+		findManyBST(gt->tree, wrapped, distinct, found);
+		//The values to insert are packed at the front of wrapped as it is read
+		for(int i=0; i<distinct; i++) {
+			GTVALUE *v = wrapped[i];
+			if(found[i] == NULL) {
+				wrapped[inserted++] = v;
+				continue;
+			}
+			GTVALUE *present = getBSTNODE(found[i]);
+			present->freq += v->freq;
+			adjustBSTNODEweight(gt->tree, found[i], v->freq);
+			if(gt->top.items != NULL)
+				moveTop(&gt->top, present);
+		}
+		keepGTVALUEs(wrapped, inserted);
+		insertMiddleFirst(gt, wrapped, 0, inserted);
+		if(gt->top.items != NULL)
+			for(int i=0; i<inserted; i++)
+				enterTop(&gt->top, wrapped[i]);
+		free(found);
+	}
+	free(block);
+	free(wrapped);
+}
+long long findGT(GT *gt, void *v) {
+	if(!passFilter(gt, v))
+		return 0;
+	GTVALUE key = keyGTVALUE(gt, v);
+	BSTNODE *node = findBST(gt->tree, &key);
+	if(node == NULL) {
+		if(gt->filter != NULL)
+			gt->falsePositives++;
 		return 0;
+	}
 	GTVALUE *value = getBSTNODE(node);
 	return value->freq;
 }
-void deleteGT(GT *gt, void *value) {
-	GTVALUE *v = newGTVALUE(value, gt->display, gt->compare);
-	//printf("before:\n");
-	//displayBST(stdout, gt->tree);
-	BSTNODE *node = findBST(gt->tree, v);
-	if(node != NULL) {
-		v = getBSTNODE(node);
-		if(v->freq > 1)
-			v->freq--;
-		else
-			node = deleteBST(gt->tree, v);
-		gt->numWords--;
+/*
+ * Looks up a batch of values with findManyBST, which overlaps the cache misses
+ * of several searches. The frequency of values[i] goes in freqs[i] and its node,
+ * or NULL, in nodes[i]; either array may be NULL. With presort the batch is
+ * searched in sorted order, so consecutive searches share the top of their
+ * paths while it is still in cache.
+ */
+void findManyGT(GT *gt, void **values, int size, long long *freqs, BSTNODE **nodes, int presort) {
+	int n = size > 0 ? size : 1;
+	GTVALUE *keys = malloc(sizeof(GTVALUE) * n);
+	void **wrapped = malloc(sizeof(void *) * n);
+	BSTNODE **found = malloc(sizeof(BSTNODE *) * n);
+	int *order = presort ? malloc(sizeof(int) * n) : NULL;
+	assert(keys != 0 && wrapped != 0 && found != 0 && (order != 0 || !presort));
+
+	for(int i=0; i<size; i++) {
+		keys[i] = keyGTVALUE(gt, values[i]);
+		wrapped[i] = &keys[i];
+		if(presort)
+			order[i] = i;
+	}
+	if(presort)
+		sortValues(wrapped, order, size, compareGTVALUE, 1);
+	findManyBST(gt->tree, wrapped, size, found);
+	for(int i=0; i<size; i++) {
+		int at = presort ? order[i] : i;
+		if(freqs != NULL)
+			freqs[at] = found[i] == NULL ? 0 : getGTNODEfreq(found[i]);
+		if(nodes != NULL)
+			nodes[at] = found[i];
+	}
+	free(keys);
+	free(wrapped);
+	free(found);
+	free(order);
+}
+/*
+ * Removes one occurrence of the value. Returns 0 if the value was not in the
+ * tree, and 1 otherwise.
+ */
+int deleteGT(GT *gt, void *value) {
+	return (int) deleteGTcount(gt, value, 1);
+}
+/*
+ * Removes up to count occurrences of the value, and the value itself once none
+ * are left. Returns the number removed.
+ */
+long long deleteGTcount(GT *gt, void *value, long long count) {
+	assert(count >= 0);
+	if(count == 0 || !passFilter(gt, value))
+		return 0;
+	GTVALUE key = keyGTVALUE(gt, value);
+	BSTNODE *node = findBST(gt->tree, &key);
+	if(node == NULL) {
+		if(gt->filter != NULL)
+			gt->falsePositives++;
+		return 0;
+	}
+	return removeGT(gt, node, count);
+}
+/*
+ * Removes up to count occurrences of the value held by the node, removing the
+ * node too once none are left. Returns the number removed.
+ */
+static long long removeGT(GT *gt, BSTNODE *node, long long count) {
+	GTVALUE *v = getBSTNODE(node);
+	if(v->freq > count) {
+		v->freq -= count;
+		adjustBSTNODEweight(gt->tree, node, -count);
+		if(gt->top.items != NULL)
+			moveTop(&gt->top, v);
 	} else {
-		printf("Value ");
-		v->display(stdout, v->value);
-		printf(" not found.\n");
+		count = v->freq;
+		if(gt->top.items != NULL)
+			leaveTop(&gt->top, v);
+		pruneLeafBST(gt->tree, node);
+		//The filter cannot forget the value, so rebuild it once half its keys are gone
+		if(gt->filter != NULL && ++gt->stale > keysBLOOM(gt->filter) / 2)
+			rebuildFilter(gt);
 	}
-	//printf("after:\n");
-	//displayBST(stdout, gt->tree);
-	//printf("\n");
+	gt->numWords -= count;
+	return count;
 }
 int sizeGT(GT *gt) {
 	return sizeBST(gt->tree);
 }
-int wordsGT(GT *gt) {
+long long wordsGT(GT *gt) {
 	return gt->numWords;
 }
 void statisticsGT(FILE *fp, GT *gt) {
-	fprintf(fp, "Words/Phrases: %d\n", wordsGT(gt));
+	fprintf(fp, "Words/Phrases: %lld\n", wordsGT(gt));
 	statisticsBST(fp, gt->tree);
+	if(gt->filter != NULL) {
+		long long misses = gt->filtered + gt->falsePositives;
+		statisticsBLOOM(fp, gt->filter);
+		fprintf(fp, "Filtered misses: %lld\n", gt->filtered);
+		fprintf(fp, "False positive rate: %.2f%%\n",
+			misses == 0 ? 0.0 : 100.0 * gt->falsePositives / misses);
+	}
 }
 void displayGT(FILE *fp, GT *gt) {
 	displayBST(fp, gt->tree);
 }
 
+/*
+ * Builds a search key on the stack so that lookups do not allocate.
+ */
+static GTVALUE keyGTVALUE(GT *gt, void *value) {
+	GTVALUE key;
+	key.value = value;
+	key.freq = 0;
+	key.rank = -1;
+	key.prefix = gt->prefix == NULL ? 0 : gt->prefix(value);
+	key.display = gt->display;
+	key.compare = gt->compare;
+	return key;
+}
+/*
+ * In-order navigation over the nodes of the tree. The nodes returned hold
+ * GTVALUEs, so getGTNODEvalue and getGTNODEfreq should be used to read them.
+ */
+BSTNODE *firstGT(GT *gt) {
+	return firstBST(gt->tree);
+}
+BSTNODE *lastGT(GT *gt) {
+	return lastBST(gt->tree);
+}
+BSTNODE *nextGT(GT *gt, BSTNODE *node) {
+	return nextBSTNODE(gt->tree, node);
+}
+BSTNODE *prevGT(GT *gt, BSTNODE *node) {
+	return prevBSTNODE(gt->tree, node);
+}
+BSTNODE *lowerBoundGT(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return lowerBoundBST(gt->tree, &key);
+}
+BSTNODE *upperBoundGT(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return upperBoundBST(gt->tree, &key);
+}
+BSTNODE *floorGT(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return floorBST(gt->tree, &key);
+}
+BSTNODE *ceilingGT(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return ceilingBST(gt->tree, &key);
+}
+void *getGTNODEvalue(BSTNODE *node) {
+	GTVALUE *v = getBSTNODE(node);
+	return v->value;
+}
+long long getGTNODEfreq(BSTNODE *node) {
+	GTVALUE *v = getBSTNODE(node);
+	return v->freq;
+}
+/*
+ * Return the smallest and largest values, or NULL if the tree is empty, in
+ * constant time.
+ */
+void *minGT(GT *gt) {
+	BSTNODE *node = firstBST(gt->tree);
+	return node == NULL ? NULL : getGTNODEvalue(node);
+}
+void *maxGT(GT *gt) {
+	BSTNODE *node = lastBST(gt->tree);
+	return node == NULL ? NULL : getGTNODEvalue(node);
+}
+/*
+ * Remove one occurrence of the smallest or largest value and return it, or
+ * return NULL if the tree is empty. The node comes from the cache, so no search
+ * is needed.
+ */
+void *popMinGT(GT *gt) {
+	BSTNODE *node = firstBST(gt->tree);
+	if(node == NULL)
+		return NULL;
+	void *value = getGTNODEvalue(node);
+	removeGT(gt, node, 1);
+	return value;
+}
+void *popMaxGT(GT *gt) {
+	BSTNODE *node = lastBST(gt->tree);
+	if(node == NULL)
+		return NULL;
+	void *value = getGTNODEvalue(node);
+	removeGT(gt, node, 1);
+	return value;
+}
+/*
+ * Visits every value in [lo, hi] in order, passing its frequency along. Runs in
+ * O(h + k) for k visited values.
+ */
+void rangeGT(GT *gt, void *lo, void *hi, void (*visit)(void *, long long, void *), void *arg) {
+	BSTNODE *node = lowerBoundGT(gt, lo);
+	while(node != NULL) {
+		GTVALUE *v = getBSTNODE(node);
+		if(gt->compare(v->value, hi) > 0)
+			break;
+		visit(v->value, v->freq, arg);
+		node = nextBSTNODE(gt->tree, node);
+	}
+}
+
+/*
+ * Order statistics over the distinct values, or over every occurrence of them in
+ * the weighted variants. k counts from 0. Each runs in time proportional to the
+ * height of the tree.
+ */
+void *selectGT(GT *gt, int k) {
+	BSTNODE *node = selectBST(gt->tree, k);
+	return node == NULL ? NULL : getGTNODEvalue(node);
+}
+int rankGT(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return rankBST(gt->tree, &key);
+}
+void *selectGTweighted(GT *gt, long long k) {
+	BSTNODE *node = selectBSTweighted(gt->tree, k);
+	return node == NULL ? NULL : getGTNODEvalue(node);
+}
+long long rankGTweighted(GT *gt, void *value) {
+	GTVALUE key = keyGTVALUE(gt, value);
+	return rankBSTweighted(gt->tree, &key);
+}
+
+/*
+ * Copies the current contents of the tree into a read-only FROZEN search
+ * structure. Later changes to the tree are not reflected in it.
+ */
+FROZEN *freezeGT(GT *gt) {
+	int size = sizeGT(gt), i = 0;
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+	for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node)) {
+		values[i] = getGTNODEvalue(node);
+		freqs[i] = getGTNODEfreq(node);
+		i++;
+	}
+	FROZEN *f = newFROZEN(gt->display, gt->compare, values, freqs, size);
+	free(values);
+	free(freqs);
+	return f;
+}
+
+/*
+ * Saves the contents of the tree to a binary snapshot at the given path, taking
+ * each value's bytes from the key callback. The file is replaced only once the
+ * new snapshot is complete. Returns 1 on success, 0 if it could not be written.
+ */
+int saveGT(GT *gt, const char *path, const unsigned char *(*key)(void *, int *)) {
+	SNAPWRITER *w = newSNAPWRITER(path);
+	if(w == NULL)
+		return 0;
+	for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node)) {
+		int length;
+		const unsigned char *bytes = key(getGTNODEvalue(node), &length);
+		writeSNAPWRITER(w, bytes, length, getGTNODEfreq(node));
+	}
+	return closeSNAPWRITER(w);
+}
+/*
+ * Creates a tree from a snapshot made by saveGT or saveRBT, turning each key
+ * back into a value with the decode callback. The file is checked against its
+ * checksum before any key is decoded, then the records are read in one pass and
+ * the tree is built from them in linear time, already balanced. Returns NULL if
+ * the file cannot be read, is not a snapshot, or fails its checksum.
+ */
+GT *loadGT(const char *path, void (*d)(FILE *, void *), int (*c)(void *, void *),
+		void *(*decode)(const unsigned char *, int)) {
+	SNAPREADER *r = newSNAPREADER(path);
+	if(r == NULL)
+		return NULL;
+	int size = sizeSNAPREADER(r);
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+	int i = 0, length;
+	const unsigned char *bytes;
+	while(i < size && (bytes = readSNAPREADER(r, &length, &freqs[i])) != NULL)
+		values[i++] = decode(bytes, length);
+	GT *gt = NULL;
+	if(closeSNAPREADER(r))
+		gt = buildGTfromSorted(d, c, values, freqs, size);
+	free(values);
+	free(freqs);
+	return gt;
+}
+
+/*
+ * Top-K by frequency, as for the RBT: a min-heap of the K best values found by
+ * a traversal, or kept exact by setGTtopK together with a max-heap of every
+ * other value, at O(log n) per change, so that a query only sorts the K. Ties
+ * go to the value that comes first in the tree.
+ */
+static int worseTop(GTVALUE *a, GTVALUE *b) {
+	if(a->freq != b->freq)
+		return a->freq < b->freq;
+	return compareGTVALUE(a, b) > 0;
+}
+/*
+ * Whether a belongs above b: in the K a parent is worse than its children, in
+ * the rest it is better, so each root is the value nearest the boundary.
+ */
+static int aboveTop(int rest, GTVALUE *a, GTVALUE *b) {
+	return rest ? worseTop(b, a) : worseTop(a, b);
+}
+/*
+ * Positions in the rest are recorded as ranks below -1.
+ */
+static void placeTop(TOPK *h, int rest, int i, GTVALUE *value) {
+	if(rest) {
+		h->rest[i] = value;
+		value->rank = -2 - i;
+	} else {
+		h->items[i] = value;
+		if(h->tracked)
+			value->rank = i;
+	}
+}
+/*
+ * Moves the value at position i down its heap until its children belong below
+ * it.
+ */
+static void sinkTop(TOPK *h, int rest, int i) {
+	GTVALUE **items = rest ? h->rest : h->items;
+	int size = rest ? h->restSize : h->size;
+	GTVALUE *value = items[i];
+	while(2 * i + 1 < size) {
+		int child = 2 * i + 1;
+		if(child + 1 < size && aboveTop(rest, items[child + 1], items[child]))
+			child++;
+		if(!aboveTop(rest, items[child], value))
+			break;
+		placeTop(h, rest, i, items[child]);
+		i = child;
+	}
+	placeTop(h, rest, i, value);
+}
+/*
+ * Moves the value at position i up or down its heap to where it belongs.
+ */
+static void siftTop(TOPK *h, int rest, int i) {
+	GTVALUE **items = rest ? h->rest : h->items;
+	GTVALUE *value = items[i];
+	while(i > 0 && aboveTop(rest, value, items[(i - 1) / 2])) {
+		placeTop(h, rest, i, items[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	placeTop(h, rest, i, value);
+	sinkTop(h, rest, i);
+}
+static void pushTop(TOPK *h, int rest, GTVALUE *value) {
+	if(!rest) {
+		placeTop(h, 0, h->size++, value);
+		siftTop(h, 0, h->size - 1);
+		return;
+	}
+	if(h->restSize == h->restCapacity) {
+		h->restCapacity = h->restCapacity > 0 ? 2 * h->restCapacity : 16;
+		h->rest = realloc(h->rest, sizeof(GTVALUE *) * h->restCapacity);
+		assert(h->rest != 0);
+	}
+	placeTop(h, 1, h->restSize++, value);
+	siftTop(h, 1, h->restSize - 1);
+}
+/*
+ * Takes the value at position i out of one of the heaps and returns it.
+ */
+static GTVALUE *takeTop(TOPK *h, int rest, int i) {
+	GTVALUE **items = rest ? h->rest : h->items;
+	int *size = rest ? &h->restSize : &h->size;
+	GTVALUE *value = items[i];
+	value->rank = -1;
+	if(i < --*size) {
+		placeTop(h, rest, i, items[*size]);
+		siftTop(h, rest, i);
+	}
+	return value;
+}
+/*
+ * Restores the boundary after a single value has changed: the K are only short
+ * when the rest is empty, and their worst beats the best of the rest. One
+ * exchange of the roots is always enough.
+ */
+static void balanceTop(TOPK *h) {
+	if(h->size < h->capacity && h->restSize > 0)
+		pushTop(h, 0, takeTop(h, 1, 0));
+	if(h->size > 0 && h->restSize > 0 && worseTop(h->items[0], h->rest[0])) {
+		GTVALUE *worst = h->items[0];
+		placeTop(h, 0, 0, h->rest[0]);
+		siftTop(h, 0, 0);
+		placeTop(h, 1, 0, worst);
+		siftTop(h, 1, 0);
+	}
+}
+/*
+ * Files a value that has just entered a tracked tree.
+ */
+static void enterTop(TOPK *h, GTVALUE *value) {
+	pushTop(h, h->size == h->capacity, value);
+	balanceTop(h);
+}
+/*
+ * Moves a tracked value whose frequency has risen or fallen.
+ */
+static void moveTop(TOPK *h, GTVALUE *value) {
+	if(value->rank >= 0)
+		siftTop(h, 0, value->rank);
+	else
+		siftTop(h, 1, -2 - value->rank);
+	balanceTop(h);
+}
+/*
+ * Drops a tracked value that is about to leave the tree.
+ */
+static void leaveTop(TOPK *h, GTVALUE *value) {
+	if(value->rank >= 0)
+		takeTop(h, 0, value->rank);
+	else
+		takeTop(h, 1, -2 - value->rank);
+	balanceTop(h);
+}
+/*
+ * Rebuilds the tracked heaps from the whole tree in O(n + K log n): every value
+ * is heapified into the rest, and the best K are then moved across.
+ */
+static void trackTop(GT *gt) {
+	TOPK *h = &gt->top;
+	int n = sizeGT(gt);
+	if(n > h->restCapacity) {
+		h->restCapacity = n;
+		h->rest = realloc(h->rest, sizeof(GTVALUE *) * n);
+		assert(h->rest != 0);
+	}
+	h->size = 0;
+	h->restSize = 0;
+	for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node))
+		placeTop(h, 1, h->restSize++, getBSTNODE(node));
+	for(int i=h->restSize/2-1; i>=0; i--)
+		sinkTop(h, 1, i);
+	while(h->size < h->capacity && h->restSize > 0)
+		pushTop(h, 0, takeTop(h, 1, 0));
+}
+/*
+ * Offers a value to an untracked heap during a traversal.
+ */
+static void offerTop(TOPK *h, GTVALUE *value) {
+	if(h->size < h->capacity)
+		pushTop(h, 0, value);
+	else if(h->size > 0 && worseTop(h->items[0], value)) {
+		placeTop(h, 0, 0, value);
+		siftTop(h, 0, 0);
+	}
+}
+static int compareTop(void *x, void *y) {
+	GTVALUE *p = x, *q = y;
+	return worseTop(q, p) ? -1 : worseTop(p, q) ? 1 : 0;
+}
+/*
+ * Keeps the k most frequent values up to date as the tree changes. A k of 0
+ * stops tracking.
+ */
+void setGTtopK(GT *gt, int k) {
+	assert(k >= 0);
+	free(gt->top.items);
+	free(gt->top.rest);
+	gt->top.items = NULL;
+	gt->top.rest = NULL;
+	gt->top.size = 0;
+	gt->top.restSize = 0;
+	gt->top.restCapacity = 0;
+	gt->top.capacity = k;
+	if(k == 0) {
+		for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node))
+			((GTVALUE *) getBSTNODE(node))->rank = -1;
+		return;
+	}
+	gt->top.items = malloc(sizeof(GTVALUE *) * k);
+	assert(gt->top.items != 0);
+	trackTop(gt);
+}
+/*
+ * Returns the k most frequent values, most frequent first. If freqs is not NULL
+ * it receives their frequencies. The tracked values answer when there are at
+ * least k of them, in O(k log k); otherwise the tree is traversed.
+ */
+DA *topKGT(GT *gt, int k, long long *freqs) {
+	assert(k >= 0);
+	TOPK local, *h = &gt->top;
+	if(h->items == NULL || k > h->capacity) {
+		local.items = malloc(sizeof(GTVALUE *) * (k > 0 ? k : 1));
+		assert(local.items != 0);
+		local.size = 0;
+		local.capacity = k;
+		local.tracked = 0;
+		for(BSTNODE *node = firstGT(gt); node != NULL; node = nextGT(gt, node))
+			offerTop(&local, getBSTNODE(node));
+		h = &local;
+	}
+
+	int size = h->size;
+	void **sorted = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	assert(sorted != 0);
+	for(int i=0; i<size; i++)
+		sorted[i] = h->items[i];
+	sortValues(sorted, NULL, size, compareTop, 1);
+	DA *result = newDA(gt->display);
+	for(int i=0; i<size && i<k; i++) {
+		GTVALUE *value = sorted[i];
+		insertDA(result, value->value);
+		if(freqs != NULL)
+			freqs[i] = value->freq;
+	}
+	free(sorted);
+	if(h == &local)
+		free(local.items);
+	return result;
+}
+
 void displayGTVALUE(FILE *fp, void *value) {
 	GTVALUE *v = value;
 	v->display(fp, v->value);
 	if(v->freq > 1)
-		fprintf(fp, "-%d", v->freq);
+		fprintf(fp, "-%lld", v->freq);
+}
+long long weighGTVALUE(void *value) {
+	GTVALUE *v = value;
+	return v->freq;
 }
 int compareGTVALUE(void *x, void *y) {
 	GTVALUE *p = x, *q = y;
 	//printf("comparing %s and %s\n", getSTRING(((STRING *)p->value)), getSTRING(((STRING *)q->value)));
+	if(p->prefix != q->prefix)
+		return p->prefix < q->prefix ? -1 : 1;
 	return p->compare(p->value, q->value);
 }
@@ -2,18 +2,72 @@
 #define __GT_INCLUDED__
 
 #include <stdio.h>
+#include "bst.h"
+#include "da.h"
+#include "frozen.h"
 
 typedef struct gt GT;
 
 extern GT *newGT(
 	void (*)(FILE *,void *),           //display
 	int (*)(void *,void *));           //comparator
+extern GT *buildGTfromSorted(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	void **values,long long *freqs,int size);
+extern GT *buildGTfromDA(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	DA *values,int threads);
+extern GT *mergeGT(GT *,GT *);
+extern void absorbGT(GT *recipient,GT *donor);
+extern void setGTprefix(GT *,
+	unsigned long long (*)(void *));   //prefix
+extern void setGTfilter(GT *,
+	unsigned (*)(void *),              //hash
+	int bitsPerKey);
 extern void insertGT(GT *,void *);
-extern int findGT(GT *,void *);
-extern void deleteGT(GT *,void *);
+extern void insertGTcount(GT *,void *,long long count);
+extern void insertManyGT(GT *,void **values,long long *counts,
+	int size,int threads);
+extern long long findGT(GT *,void *);
+extern void findManyGT(GT *,void **values,int size,
+	long long *freqs,BSTNODE **nodes,int presort);
+extern int deleteGT(GT *,void *);
+extern long long deleteGTcount(GT *,void *,long long count);
 extern int sizeGT(GT *);
-extern int wordsGT(GT *);
+extern long long wordsGT(GT *);
 extern void statisticsGT(FILE *,GT *);
 extern void displayGT(FILE *,GT *);
+extern BSTNODE *firstGT(GT *);
+extern BSTNODE *lastGT(GT *);
+extern BSTNODE *nextGT(GT *,BSTNODE *);
+extern BSTNODE *prevGT(GT *,BSTNODE *);
+extern BSTNODE *lowerBoundGT(GT *,void *);
+extern BSTNODE *upperBoundGT(GT *,void *);
+extern BSTNODE *floorGT(GT *,void *);
+extern BSTNODE *ceilingGT(GT *,void *);
+extern void *getGTNODEvalue(BSTNODE *);
+extern long long getGTNODEfreq(BSTNODE *);
+extern void *minGT(GT *);
+extern void *maxGT(GT *);
+extern void *popMinGT(GT *);
+extern void *popMaxGT(GT *);
+extern void rangeGT(GT *,void *lo,void *hi,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void *selectGT(GT *,int k);
+extern int  rankGT(GT *,void *);
+extern void *selectGTweighted(GT *,long long k);
+extern long long rankGTweighted(GT *,void *);
+extern FROZEN *freezeGT(GT *);
+extern int  saveGT(GT *,const char *path,
+	const unsigned char *(*)(void *,int *)); //key
+extern GT  *loadGT(const char *path,
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	void *(*)(const unsigned char *,int)); //decode
+extern void setGTtopK(GT *,int k);
+extern DA  *topKGT(GT *,int k,long long *freqs);
 
 #endif
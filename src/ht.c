@@ -0,0 +1,438 @@
+#include "ht.h"
+#include "sort.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contains the implementation for a frequency counting hash table, for when the
+ * values are only ever counted and looked up and their order is not needed. The
+ * table uses open addressing in the style of SwissTable: next to the slots is an
+ * array of one control byte per slot, holding 7 bits of the value's hash when
+ * the slot is full or a marker when it is empty or deleted. A lookup compares
+ * the control bytes of a group of 16 slots with the hash bits all at once, and
+ * calls the equality callback only for the slots that match. Groups are probed
+ * in a triangular sequence, which visits every group of a power-of-two table.
+ *
+ * When the table fills up, a larger one is allocated and the slots are moved
+ * across a few at a time by the following inserts and deletes, so no single
+ * call pays for the whole rehash. Until the move finishes, lookups check both
+ * tables.
+ */
+
+#define GROUP 16
+#define EMPTY ((signed char) -128)
+#define DELETED ((signed char) -2)
+#define MINIMUM_CAPACITY 16
+#define MIGRATE_STEP 32         //slots moved from the old table per insert or delete
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+/*
+ * Returns a bit mask of the slots in the group whose control byte is the given one.
+ */
+static unsigned matchGroup(signed char *control, signed char byte) {
+	__m128i group = _mm_loadu_si128((__m128i *) control);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+}
+/*
+ * Returns a bit mask of the slots in the group that are empty or deleted, whose
+ * control bytes are the only negative ones.
+ */
+static unsigned matchFree(signed char *control) {
+	return _mm_movemask_epi8(_mm_loadu_si128((__m128i *) control));
+}
+#else
+static unsigned matchGroup(signed char *control, signed char byte) {
+	unsigned mask = 0;
+	for(int i=0; i<GROUP; i++)
+		mask |= (unsigned) (control[i] == byte) << i;
+	return mask;
+}
+static unsigned matchFree(signed char *control) {
+	unsigned mask = 0;
+	for(int i=0; i<GROUP; i++)
+		mask |= (unsigned) (control[i] < 0) << i;
+	return mask;
+}
+#endif
+
+#ifdef __GNUC__
+#define LOWEST(mask) __builtin_ctz(mask)
+#else
+static int LOWEST(unsigned mask) {
+	int i = 0;
+	while(!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+}
+#endif
+
+typedef struct htslot {
+	void *value;
+	unsigned hash;          //the mixed hash, so a rehash never calls the user's hash
+	long long freq;
+} SLOT;
+
+typedef struct httable {
+	signed char *control;
+	SLOT *slots;
+	int capacity, used;     //used counts the full and the deleted slots
+} TABLE;
+
+struct ht {
+	TABLE current, old;     //old.control is NULL unless a rehash is under way
+	int size, moved;
+	long long words, rehashes;
+	void (*display)(FILE *, void *);
+	unsigned (*hash)(void *);
+	int (*equals)(void *, void *);
+};
+
+static TABLE newTABLE(int capacity) {
+	TABLE table;
+	table.capacity = capacity;
+	table.used = 0;
+	table.control = malloc(capacity);
+	table.slots = malloc(sizeof(SLOT) * capacity);
+	assert(table.control != 0 && table.slots != 0);
+	memset(table.control, EMPTY, capacity);
+	return table;
+}
+static void freeTABLE(TABLE *table) {
+	free(table->control);
+	free(table->slots);
+	table->control = NULL;
+	table->slots = NULL;
+}
+
+HT *newHT(void (*d)(FILE *, void *), unsigned (*h)(void *), int (*e)(void *, void *)) {
+	HT *t = malloc(sizeof(HT));
+	assert(t != 0);
+
+	t->current = newTABLE(MINIMUM_CAPACITY);
+	t->old.control = NULL;
+	t->old.slots = NULL;
+	t->size = 0;
+	t->words = 0;
+	t->moved = 0;
+	t->rehashes = 0;
+	t->display = d;
+	t->hash = h;
+	t->equals = e;
+	return t;
+}
+
+/*
+ * Spreads the user's hash over all 32 bits, since the low 7 bits go into the
+ * control bytes and the rest pick the group.
+ */
+static unsigned mix(unsigned h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+/*
+ * Returns the index of the slot holding the value, or -1 if it is not in the
+ * table. If open is not NULL, it is set to the first empty or deleted slot on the
+ * probe sequence, where the value would be inserted.
+ */
+static int probe(HT *t, TABLE *table, void *value, unsigned h, int *open) {
+	unsigned groups = table->capacity / GROUP;
+	unsigned g = (h >> 7) & (groups-1);
+	signed char tag = h & 0x7f;
+	if(open != NULL)
+		*open = -1;
+	for(unsigned step=1; ; step++) {
+		signed char *control = table->control + g*GROUP;
+		unsigned mask = matchGroup(control, tag);
+		while(mask != 0) {
+			int i = g*GROUP + LOWEST(mask);
+			if(table->slots[i].hash == h && t->equals(table->slots[i].value, value))
+				return i;
+			mask &= mask - 1;
+		}
+		if(open != NULL && *open < 0) {
+			unsigned spare = matchFree(control);
+			if(spare != 0)
+				*open = g*GROUP + LOWEST(spare);
+		}
+		if(matchGroup(control, EMPTY) != 0)
+			return -1;
+		g = (g + step) & (groups-1);
+	}
+}
+/*
+ * Returns the first empty or deleted slot on the probe sequence for the hash.
+ */
+static int findFree(TABLE *table, unsigned h) {
+	unsigned groups = table->capacity / GROUP;
+	unsigned g = (h >> 7) & (groups-1);
+	for(unsigned step=1; ; step++) {
+		unsigned open = matchFree(table->control + g*GROUP);
+		if(open != 0)
+			return g*GROUP + LOWEST(open);
+		g = (g + step) & (groups-1);
+	}
+}
+static void fill(TABLE *table, int i, void *value, unsigned h, long long freq) {
+	if(table->control[i] == EMPTY)
+		table->used++;
+	table->control[i] = h & 0x7f;
+	table->slots[i].value = value;
+	table->slots[i].hash = h;
+	table->slots[i].freq = freq;
+}
+/*
+ * Empties a slot. A probe stops at the first group with an empty slot, so the
+ * slot can only be marked empty again if its group already has one; otherwise
+ * it becomes a tombstone that probes pass over.
+ */
+static void erase(TABLE *table, int i) {
+	if(matchGroup(table->control + i/GROUP*GROUP, EMPTY) != 0) {
+		table->control[i] = EMPTY;
+		table->used--;
+	} else
+		table->control[i] = DELETED;
+}
+/*
+ * Moves up to count slots from the old table into the current one, and frees
+ * the old table once all of them have moved.
+ */
+static void migrate(HT *t, int count) {
+	TABLE *old = &t->old;
+	while(count-- > 0 && t->moved < old->capacity) {
+		int i = t->moved++;
+		if(old->control[i] >= 0) {
+			SLOT *s = &old->slots[i];
+			fill(&t->current, findFree(&t->current, s->hash), s->value, s->hash, s->freq);
+			old->control[i] = DELETED;
+		}
+	}
+	if(t->moved == old->capacity)
+		freeTABLE(old);
+}
+/*
+ * Starts a rehash into a new table. The table doubles unless at least half of its
+ * used slots are tombstones, in which case it is only cleaned at the same size.
+ */
+static void grow(HT *t) {
+	if(t->old.control != NULL)
+		migrate(t, t->old.capacity);
+	int capacity = t->current.capacity;
+	if(t->size >= capacity / 16 * 7)
+		capacity *= 2;
+	t->old = t->current;
+	t->current = newTABLE(capacity);
+	t->moved = 0;
+	t->rehashes++;
+}
+
+void insertHT(HT *t, void *value) {
+	unsigned h = mix(t->hash(value));
+	if(t->old.control != NULL)
+		migrate(t, MIGRATE_STEP);
+	int open;
+	int i = probe(t, &t->current, value, h, &open);
+	if(i >= 0) {
+		t->current.slots[i].freq++;
+		t->words++;
+		return;
+	}
+	if(t->old.control != NULL && (i = probe(t, &t->old, value, h, NULL)) >= 0) {
+		t->old.slots[i].freq++;
+		t->words++;
+		return;
+	}
+	if(t->current.control[open] == EMPTY && t->current.used + 1 > t->current.capacity / 8 * 7) {
+		grow(t);
+		open = findFree(&t->current, h);
+	}
+	fill(&t->current, open, value, h, 1);
+	t->size++;
+	t->words++;
+}
+/*
+ * Returns the frequency of the value, or 0 if it is not in the table.
+ */
+long long findHT(HT *t, void *value) {
+	unsigned h = mix(t->hash(value));
+	int i = probe(t, &t->current, value, h, NULL);
+	if(i >= 0)
+		return t->current.slots[i].freq;
+	if(t->old.control != NULL && (i = probe(t, &t->old, value, h, NULL)) >= 0)
+		return t->old.slots[i].freq;
+	return 0;
+}
+/*
+ * Returns the value stored in the table that equals the given one, or NULL if
+ * there is none. Lets the table be used to intern values.
+ */
+void *getHT(HT *t, void *value) {
+	unsigned h = mix(t->hash(value));
+	int i = probe(t, &t->current, value, h, NULL);
+	if(i >= 0)
+		return t->current.slots[i].value;
+	if(t->old.control != NULL && (i = probe(t, &t->old, value, h, NULL)) >= 0)
+		return t->old.slots[i].value;
+	return NULL;
+}
+/*
+ * Removes one occurrence of the value. Returns 0 if the value was not in the
+ * table, and 1 otherwise.
+ */
+int deleteHT(HT *t, void *value) {
+	unsigned h = mix(t->hash(value));
+	if(t->old.control != NULL)
+		migrate(t, MIGRATE_STEP);
+	TABLE *table = &t->current;
+	int i = probe(t, table, value, h, NULL);
+	if(i < 0 && t->old.control != NULL) {
+		table = &t->old;
+		i = probe(t, table, value, h, NULL);
+	}
+	if(i < 0)
+		return 0;
+	t->words--;
+	if(--table->slots[i].freq == 0) {
+		erase(table, i);
+		t->size--;
+	}
+	return 1;
+}
+int sizeHT(HT *t) {
+	return t->size;
+}
+long long wordsHT(HT *t) {
+	return t->words;
+}
+/*
+ * Visits every value with its frequency, in no particular order.
+ */
+void walkHT(HT *t, void (*visit)(void *, long long, void *), void *arg) {
+	TABLE *tables[2] = { &t->current, &t->old };
+	for(int k=0; k<2; k++) {
+		TABLE *table = tables[k];
+		if(table->control == NULL)
+			continue;
+		for(int i=0; i<table->capacity; i++)
+			if(table->control[i] >= 0)
+				visit(table->slots[i].value, table->slots[i].freq, arg);
+	}
+}
+
+typedef struct htexport {
+	void **values;
+	long long *freqs;
+	int count;
+} EXPORT;
+
+static void exportValue(void *value, long long freq, void *arg) {
+	EXPORT *e = arg;
+	e->values[e->count] = value;
+	if(e->freqs != NULL)
+		e->freqs[e->count] = freq;
+	e->count++;
+}
+/*
+ * Fills values, and freqs unless it is NULL, with the contents of the table
+ * sorted by the comparator, for when an ordered view is needed. Both arrays must
+ * have room for sizeHT values, and come out as buildRBTfromSorted,
+ * buildGTfromSorted and newFROZEN expect them. The sort only carries int
+ * payloads, so it sorts the positions of the values and the frequencies are
+ * permuted after it. Returns the number of values.
+ */
+int sortedHT(HT *t, int (*c)(void *, void *), void **values, long long *freqs, int threads) {
+	EXPORT e;
+	e.values = values;
+	e.freqs = freqs;
+	e.count = 0;
+	walkHT(t, exportValue, &e);
+	if(freqs == NULL) {
+		sortValues(values, NULL, e.count, c, threads);
+		return e.count;
+	}
+
+	int n = e.count > 0 ? e.count : 1;
+	int *order = malloc(sizeof(int) * n);
+	long long *walked = malloc(sizeof(long long) * n);
+	assert(order != 0 && walked != 0);
+	for(int i=0; i<e.count; i++) {
+		order[i] = i;
+		walked[i] = freqs[i];
+	}
+	sortValues(values, order, e.count, c, threads);
+	for(int i=0; i<e.count; i++)
+		freqs[i] = walked[order[i]];
+	free(order);
+	free(walked);
+	return e.count;
+}
+
+/*
+ * Returns the number of groups a lookup for the slot's value visits.
+ */
+static int probeLength(TABLE *table, int i) {
+	unsigned groups = table->capacity / GROUP;
+	unsigned g = (table->slots[i].hash >> 7) & (groups-1);
+	int length = 1;
+	for(unsigned step=1; g != (unsigned) i/GROUP; step++) {
+		g = (g + step) & (groups-1);
+		length++;
+	}
+	return length;
+}
+void statisticsHT(FILE *fp, HT *t) {
+	long long full = 0, probes = 0;
+	TABLE *table = &t->current;
+	for(int i=0; i<table->capacity; i++)
+		if(table->control[i] >= 0) {
+			full++;
+			probes += probeLength(table, i);
+		}
+	fprintf(fp, "Words/Phrases: %lld\n", t->words);
+	fprintf(fp, "Keys: %d\n", t->size);
+	fprintf(fp, "Capacity: %d\n", table->capacity);
+	fprintf(fp, "Load factor: %.2f\n", (double) full / table->capacity);
+	fprintf(fp, "Tombstones: %lld\n", table->used - full);
+	fprintf(fp, "Average probe length: %.2f groups\n", full == 0 ? 0.0 : (double) probes / full);
+	fprintf(fp, "Rehashes: %lld\n", t->rehashes);
+	if(t->old.control != NULL)
+		fprintf(fp, "Rehash in progress: %d/%d slots moved\n", t->moved, t->old.capacity);
+}
+static void displayValue(void *value, long long freq, void *arg) {
+	HT *t = ((void **) arg)[0];
+	int *first = ((void **) arg)[1];
+	FILE *fp = ((void **) arg)[2];
+	if(!*first)
+		fputc(',', fp);
+	*first = 0;
+	t->display(fp, value);
+	if(freq > 1)
+		fprintf(fp, "-%lld", freq);
+}
+/*
+ * Prints out the values in table order, each followed by its frequency when
+ * that is greater than 1.
+ */
+void displayHT(FILE *fp, HT *t) {
+	int first = 1;
+	void *arg[3] = { t, &first, fp };
+	fputc('[', fp);
+	walkHT(t, displayValue, arg);
+	fputs("]\n", fp);
+}
+/*
+ * Frees the table. The values themselves are still owned by the caller.
+ */
+void freeHT(HT *t) {
+	freeTABLE(&t->current);
+	if(t->old.control != NULL)
+		freeTABLE(&t->old);
+	free(t);
+}
@@ -0,0 +1,28 @@
+#ifndef __HT_INCLUDED__
+#define __HT_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct ht HT;
+
+extern HT *newHT(
+	void (*)(FILE *,void *),           //display
+	unsigned (*)(void *),              //hash
+	int (*)(void *,void *));           //equals
+extern void insertHT(HT *,void *);
+extern long long findHT(HT *,void *);
+extern void *getHT(HT *,void *);
+extern int  deleteHT(HT *,void *);
+extern int  sizeHT(HT *);
+extern long long wordsHT(HT *);
+extern void walkHT(HT *,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern int  sortedHT(HT *,
+	int (*)(void *,void *),            //comparator
+	void **values,long long *freqs,int threads);
+extern void statisticsHT(FILE *,HT *);
+extern void displayHT(FILE *,HT *);
+extern void freeHT(HT *);
+
+#endif
@@ -0,0 +1,420 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ingest.h"
+#include "queue.h"
+#include "da.h"
+#include "ht.h"
+#include <assert.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Contains the implementation for a word counting pipeline that feeds an RBT or
+ * a GT. It runs in three stages:
+ *
+ * Read: one thread reads the files in chunks, holding back the partial token at
+ * the end of each chunk so that no token is split between two chunks, and puts
+ * the chunks on a bounded queue.
+ *
+ * Count: the worker threads take chunks off the queue, split them into tokens
+ * and count the tokens in an HT of their own, so they share nothing but the
+ * queue. Once the queue runs dry, each worker sorts its counts.
+ *
+ * Merge: the sorted counts of the workers are merged, adding up the frequencies
+ * of tokens that several workers saw, and the tree is built from the result in
+ * linear time.
+ *
+ * A token is a run of letters, digits and bytes above 127, so UTF-8 words stay
+ * whole. Tokens are stored as NUL-terminated strings allocated by the pipeline;
+ * they are owned by the caller once the tree is returned.
+ */
+
+#define QUEUE_DEPTH 2           //chunks waiting on the queue per worker
+
+typedef struct ingestchunk {
+	char *data;
+	int length;
+} CHUNK;
+
+/*
+ * A QUEUE guarded by a mutex. Puts wait while it holds capacity chunks, takes
+ * wait while it is empty, and a take from a closed, empty channel returns NULL.
+ */
+typedef struct ingestchannel {
+	QUEUE *items;
+	pthread_mutex_t lock;
+	pthread_cond_t ready, room;
+	int capacity, closed;
+	long long fullWaits, emptyWaits;
+} CHANNEL;
+
+typedef struct ingestworker {
+	INGEST *ingest;
+	pthread_t thread;
+	HT *counts;
+	void **values;
+	long long *freqs;
+	int size;
+	long long tokens;
+	double busy, finished;
+} WORKER;
+
+struct ingest {
+	DA *paths;
+	int threads, chunkSize, fold;
+	CHANNEL channel;
+	//statistics of the last run
+	int unreadable, distinct;
+	long long bytes, chunks, tokens;
+	double start, readEnd, countEnd, mergeEnd, countBusy;
+};
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+INGEST *newINGEST(int threads, int chunkSize) {
+	assert(threads > 0 && chunkSize > 0);
+	INGEST *p = malloc(sizeof(INGEST));
+	assert(p != 0);
+
+	p->paths = newDA(NULL);
+	p->threads = threads;
+	p->chunkSize = chunkSize;
+	p->fold = 1;
+	p->unreadable = 0;
+	p->distinct = 0;
+	p->bytes = 0;
+	p->chunks = 0;
+	p->tokens = 0;
+	p->start = p->readEnd = p->countEnd = p->mergeEnd = p->countBusy = 0;
+	return p;
+}
+void addINGESTfile(INGEST *p, char *path) {
+	insertDA(p->paths, path);
+}
+/*
+ * Sets whether ASCII letters are folded to lower case before counting. Folding
+ * is on by default.
+ */
+void setINGESTfold(INGEST *p, int fold) {
+	p->fold = fold;
+}
+
+int compareTOKEN(void *a, void *b) {
+	return strcmp(a, b);
+}
+void displayTOKEN(FILE *fp, void *token) {
+	fputs(token, fp);
+}
+static unsigned hashTOKEN(void *token) {
+	unsigned h = 2166136261u;
+	for(unsigned char *s = token; *s != '\0'; s++)
+		h = (h ^ *s) * 16777619u;
+	return h;
+}
+static int equalsTOKEN(void *a, void *b) {
+	return strcmp(a, b) == 0;
+}
+static int isToken(int c) {
+	return isalnum(c) || c > 127;
+}
+
+static void openCHANNEL(CHANNEL *c, int capacity) {
+	c->items = newQUEUE(NULL);
+	pthread_mutex_init(&c->lock, NULL);
+	pthread_cond_init(&c->ready, NULL);
+	pthread_cond_init(&c->room, NULL);
+	c->capacity = capacity;
+	c->closed = 0;
+	c->fullWaits = 0;
+	c->emptyWaits = 0;
+}
+static void putCHANNEL(CHANNEL *c, CHUNK *chunk) {
+	pthread_mutex_lock(&c->lock);
+	while(sizeQUEUE(c->items) >= c->capacity) {
+		c->fullWaits++;
+		pthread_cond_wait(&c->room, &c->lock);
+	}
+	enqueue(c->items, chunk);
+	pthread_cond_signal(&c->ready);
+	pthread_mutex_unlock(&c->lock);
+}
+static CHUNK *takeCHANNEL(CHANNEL *c) {
+	pthread_mutex_lock(&c->lock);
+	while(sizeQUEUE(c->items) == 0 && !c->closed) {
+		c->emptyWaits++;
+		pthread_cond_wait(&c->ready, &c->lock);
+	}
+	CHUNK *chunk = sizeQUEUE(c->items) == 0 ? NULL : dequeue(c->items);
+	pthread_cond_signal(&c->room);
+	pthread_mutex_unlock(&c->lock);
+	return chunk;
+}
+static void closeCHANNEL(CHANNEL *c) {
+	pthread_mutex_lock(&c->lock);
+	c->closed = 1;
+	pthread_cond_broadcast(&c->ready);
+	pthread_mutex_unlock(&c->lock);
+}
+static void destroyCHANNEL(CHANNEL *c) {
+	pthread_mutex_destroy(&c->lock);
+	pthread_cond_destroy(&c->ready);
+	pthread_cond_destroy(&c->room);
+}
+
+/*
+ * Sends the first length bytes of the buffer as a chunk. One byte is left spare
+ * so the workers can terminate the last token in place.
+ */
+static void sendChunk(INGEST *p, char *buffer, int length) {
+	CHUNK *chunk = malloc(sizeof(CHUNK));
+	assert(chunk != 0);
+	chunk->data = malloc(length + 1);
+	assert(chunk->data != 0);
+	memcpy(chunk->data, buffer, length);
+	chunk->length = length;
+	p->chunks++;
+	putCHANNEL(&p->channel, chunk);
+}
+/*
+ * The read stage. Each chunk ends at the last non-token byte read so far; the
+ * bytes after it start the next chunk. A token longer than a whole chunk just
+ * makes the buffer grow until it ends.
+ */
+static void readFiles(INGEST *p) {
+	int capacity = p->chunkSize * 2, held = 0;
+	char *buffer = malloc(capacity);
+	assert(buffer != 0);
+	for(int f=0; f<sizeDA(p->paths); f++) {
+		char *path = getDA(p->paths, f);
+		FILE *fp = fopen(path, "rb");
+		if(fp == NULL) {
+			fprintf(stderr, "Cannot read %s.\n", path);
+			p->unreadable++;
+			continue;
+		}
+		while(1) {
+			if(held + p->chunkSize > capacity) {
+				capacity = held + p->chunkSize;
+				buffer = realloc(buffer, capacity);
+				assert(buffer != 0);
+			}
+			int got = fread(buffer + held, 1, p->chunkSize, fp);
+			p->bytes += got;
+			held += got;
+			if(got == 0)
+				break;
+			int end = held;
+			while(end > 0 && isToken((unsigned char) buffer[end-1]))
+				end--;
+			if(end > 0) {
+				sendChunk(p, buffer, end);
+				memmove(buffer, buffer + end, held - end);
+				held -= end;
+			}
+		}
+		//The end of a file ends its last token
+		if(held > 0)
+			sendChunk(p, buffer, held);
+		held = 0;
+		fclose(fp);
+	}
+	free(buffer);
+}
+/*
+ * Counts the tokens of a chunk, terminating each one in place so it can be
+ * looked up without a copy. Only the first occurrence of a token is copied.
+ */
+static void countChunk(WORKER *w, CHUNK *chunk) {
+	char *data = chunk->data;
+	int fold = w->ingest->fold;
+	data[chunk->length] = '\0';
+	int i = 0;
+	while(i < chunk->length) {
+		while(i < chunk->length && !isToken((unsigned char) data[i]))
+			i++;
+		if(i == chunk->length)
+			break;
+		char *token = data + i;
+		while(i < chunk->length && isToken((unsigned char) data[i])) {
+			if(fold)
+				data[i] = tolower((unsigned char) data[i]);
+			i++;
+		}
+		data[i++] = '\0';
+		if(findHT(w->counts, token) == 0) {
+			char *copy = malloc(strlen(token) + 1);
+			assert(copy != 0);
+			strcpy(copy, token);
+			token = copy;
+		}
+		insertHT(w->counts, token);
+		w->tokens++;
+	}
+}
+/*
+ * The count stage, run by each worker.
+ */
+static void *countTokens(void *arg) {
+	WORKER *w = arg;
+	CHUNK *chunk;
+	while((chunk = takeCHANNEL(&w->ingest->channel)) != NULL) {
+		double begin = now();
+		countChunk(w, chunk);
+		w->busy += now() - begin;
+		free(chunk->data);
+		free(chunk);
+	}
+	w->finished = now();
+	w->size = sizeHT(w->counts);
+	w->values = malloc(sizeof(void *) * (w->size + 1));
+	w->freqs = malloc(sizeof(long long) * (w->size + 1));
+	assert(w->values != 0 && w->freqs != 0);
+	sortedHT(w->counts, compareTOKEN, w->values, w->freqs, 1);
+	freeHT(w->counts);
+	return NULL;
+}
+/*
+ * The merge stage. Merges the workers' sorted counts into values and freqs, and
+ * frees the copies of tokens that more than one worker saw. Returns the number
+ * of distinct tokens.
+ */
+static int mergeCounts(WORKER *workers, int count, void **values, long long *freqs) {
+	int *next = calloc(count, sizeof(int));
+	assert(next != 0);
+	int size = 0;
+	while(1) {
+		int least = -1;
+		for(int i=0; i<count; i++)
+			if(next[i] < workers[i].size && (least < 0
+					|| strcmp(workers[i].values[next[i]], workers[least].values[next[least]]) < 0))
+				least = i;
+		if(least < 0)
+			break;
+		void *token = workers[least].values[next[least]];
+		values[size] = token;
+		freqs[size] = 0;
+		for(int i=0; i<count; i++)
+			if(next[i] < workers[i].size && strcmp(workers[i].values[next[i]], token) == 0) {
+				freqs[size] += workers[i].freqs[next[i]];
+				if(workers[i].values[next[i]] != token)
+					free(workers[i].values[next[i]]);
+				next[i]++;
+			}
+		size++;
+	}
+	free(next);
+	return size;
+}
+/*
+ * Runs the three stages and leaves the merged counts, sorted, in values and
+ * freqs. The caller frees both arrays.
+ */
+static int run(INGEST *p, void ***values, long long **freqs) {
+	p->unreadable = 0;
+	p->bytes = 0;
+	p->chunks = 0;
+	p->tokens = 0;
+	p->countBusy = 0;
+	p->start = now();
+	openCHANNEL(&p->channel, p->threads * QUEUE_DEPTH);
+
+	WORKER *workers = malloc(sizeof(WORKER) * p->threads);
+	assert(workers != 0);
+	for(int i=0; i<p->threads; i++) {
+		workers[i].ingest = p;
+		workers[i].counts = newHT(displayTOKEN, hashTOKEN, equalsTOKEN);
+		workers[i].tokens = 0;
+		workers[i].busy = 0;
+		int created = pthread_create(&workers[i].thread, NULL, countTokens, &workers[i]);
+		assert(created == 0);
+	}
+	readFiles(p);
+	p->readEnd = now();
+	closeCHANNEL(&p->channel);
+
+	int total = 0;
+	p->countEnd = p->readEnd;
+	for(int i=0; i<p->threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].size;
+		p->tokens += workers[i].tokens;
+		p->countBusy += workers[i].busy;
+		if(workers[i].finished > p->countEnd)
+			p->countEnd = workers[i].finished;
+	}
+	destroyCHANNEL(&p->channel);
+
+	*values = malloc(sizeof(void *) * (total + 1));
+	*freqs = malloc(sizeof(long long) * (total + 1));
+	assert(*values != 0 && *freqs != 0);
+	p->distinct = mergeCounts(workers, p->threads, *values, *freqs);
+	for(int i=0; i<p->threads; i++) {
+		free(workers[i].values);
+		free(workers[i].freqs);
+	}
+	free(workers);
+	return p->distinct;
+}
+/*
+ * Counts the tokens of every file added so far into a new RBT, which uses
+ * compareTOKEN and displayTOKEN.
+ */
+RBT *ingestRBT(INGEST *p) {
+	void **values;
+	long long *freqs;
+	int size = run(p, &values, &freqs);
+	RBT *rbt = buildRBTfromSorted(displayTOKEN, compareTOKEN, values, freqs, size);
+	p->mergeEnd = now();
+	free(values);
+	free(freqs);
+	return rbt;
+}
+/*
+ * Counts the tokens of every file added so far into a new GT.
+ */
+GT *ingestGT(INGEST *p) {
+	void **values;
+	long long *freqs;
+	int size = run(p, &values, &freqs);
+	GT *gt = buildGTfromSorted(displayTOKEN, compareTOKEN, values, freqs, size);
+	p->mergeEnd = now();
+	free(values);
+	free(freqs);
+	return gt;
+}
+
+static double rate(double amount, double seconds) {
+	return seconds > 0 ? amount / seconds : 0;
+}
+/*
+ * Prints the totals and the throughput of each stage of the last run. The read
+ * stage runs from the start until the last chunk is queued, the count stage
+ * until the last worker runs out of chunks, and the merge stage until the tree
+ * is built.
+ */
+void statisticsINGEST(FILE *fp, INGEST *p) {
+	double read = p->readEnd - p->start;
+	double count = p->countEnd - p->start;
+	double merge = p->mergeEnd - p->countEnd;
+	fprintf(fp, "Files: %d(%d unreadable)\n", sizeDA(p->paths), p->unreadable);
+	fprintf(fp, "Bytes: %lld in %lld chunks\n", p->bytes, p->chunks);
+	fprintf(fp, "Tokens: %lld(%d distinct)\n", p->tokens, p->distinct);
+	fprintf(fp, "Read stage: %.3fs, %.1f MB/s\n", read, rate(p->bytes / 1e6, read));
+	fprintf(fp, "Count stage: %.3fs, %.2f M tokens/s, %d threads %.0f%% busy\n", count,
+		rate(p->tokens / 1e6, count), p->threads, 100 * rate(p->countBusy, count * p->threads));
+	fprintf(fp, "Merge stage: %.3fs, %.2f M distinct tokens/s\n", merge, rate(p->distinct / 1e6, merge));
+	fprintf(fp, "Queue full waits: %lld\n", p->channel.fullWaits);
+	fprintf(fp, "Queue empty waits: %lld\n", p->channel.emptyWaits);
+}
+/*
+ * Frees the pipeline. The paths are still owned by the caller.
+ */
+void freeINGEST(INGEST *p) {
+	free(p);
+}
@@ -0,0 +1,21 @@
+#ifndef __INGEST_INCLUDED__
+#define __INGEST_INCLUDED__
+
+#include <stdio.h>
+#include "rbt.h"
+#include "gt.h"
+
+typedef struct ingest INGEST;
+
+extern INGEST *newINGEST(int threads,int chunkSize);
+extern void addINGESTfile(INGEST *,char *path);
+extern void setINGESTfold(INGEST *,int fold);
+extern RBT *ingestRBT(INGEST *);
+extern GT  *ingestGT(INGEST *);
+extern void statisticsINGEST(FILE *,INGEST *);
+extern void freeINGEST(INGEST *);
+
+extern int  compareTOKEN(void *,void *);
+extern void displayTOKEN(FILE *,void *);
+
+#endif
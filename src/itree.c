@@ -0,0 +1,11 @@
+#include "itree.h"
+
+/*
+ * Contains the integer keyed trees generated from ktree.h. Keys are compared
+ * in place, without a comparator call.
+ */
+
+#define COMPARE_INT64(a,b) (((a) > (b)) - ((a) < (b)))
+
+DEFINE_KTREE(IRBT, int64_t, COMPARE_INT64, 1)
+DEFINE_KTREE(IGT, int64_t, COMPARE_INT64, 0)
@@ -0,0 +1,15 @@
+#ifndef __ITREE_INCLUDED__
+#define __ITREE_INCLUDED__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ktree.h"
+
+/*
+ * Frequency counting trees keyed directly by 64-bit integers. IRBT is the
+ * red-black version and IGT the unbalanced green tree version.
+ */
+DECLARE_KTREE(IRBT, int64_t)
+DECLARE_KTREE(IGT, int64_t)
+
+#endif
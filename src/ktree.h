@@ -0,0 +1,336 @@
+#ifndef __KTREE_INCLUDED__
+#define __KTREE_INCLUDED__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Macros that generate a frequency counting tree specialized for one key type.
+ * Keys are stored by value inside the nodes and compared with an inline
+ * expression, so a search makes no calls through function pointers and no extra
+ * dereference per level, unlike the RBT and GT which go through their
+ * RBTVALUE/GTVALUE wrappers and the user's comparator.
+ *
+ * DECLARE_KTREE(NAME, KEY) declares the type NAME and its functions for a header.
+ * DEFINE_KTREE(NAME, KEY, CMP, BALANCED) expands to the implementation. CMP(a,b)
+ * must return a negative, zero or positive int like a comparator. When BALANCED
+ * is 1 the tree is a red-black tree, when 0 it behaves like the GT and is left
+ * unbalanced.
+ *
+ * The generated functions mirror the RBT/GT ones: newNAME, insertNAME, findNAME,
+ * deleteNAME (returns 0 when the key was not found), sizeNAME, wordsNAME,
+ * statisticsNAME and freeNAME.
+ */
+
+#define KTREE_RED 0
+#define KTREE_BLACK 1
+
+#define DECLARE_KTREE(NAME, KEY) \
+	typedef struct NAME##tree NAME; \
+	extern NAME *new##NAME(void); \
+	extern void insert##NAME(NAME *t,KEY key); \
+	extern int  find##NAME(NAME *t,KEY key); \
+	extern int  delete##NAME(NAME *t,KEY key); \
+	extern int  size##NAME(NAME *t); \
+	extern int  words##NAME(NAME *t); \
+	extern void statistics##NAME(FILE *fp,NAME *t); \
+	extern void free##NAME(NAME *t);
+
+#define DEFINE_KTREE(NAME, KEY, CMP, BALANCED) \
+typedef struct NAME##node { \
+	KEY key; \
+	int freq, color; \
+	struct NAME##node *parent, *left, *right; \
+} NAME##NODE; \
+\
+struct NAME##tree { \
+	NAME##NODE *root; \
+	int size, words; \
+}; \
+\
+NAME *new##NAME(void) { \
+	NAME *t = malloc(sizeof(NAME)); \
+	assert(t != 0); \
+	t->root = NULL; \
+	t->size = 0; \
+	t->words = 0; \
+	return t; \
+} \
+\
+static int NAME##color(NAME##NODE *n) { \
+	return n == NULL ? KTREE_BLACK : n->color; \
+} \
+static void NAME##rotateLeft(NAME *t, NAME##NODE *x) { \
+	NAME##NODE *y = x->right; \
+	x->right = y->left; \
+	if(y->left != NULL) \
+		y->left->parent = x; \
+	y->parent = x->parent; \
+	if(x->parent == NULL) \
+		t->root = y; \
+	else if(x == x->parent->left) \
+		x->parent->left = y; \
+	else \
+		x->parent->right = y; \
+	y->left = x; \
+	x->parent = y; \
+} \
+static void NAME##rotateRight(NAME *t, NAME##NODE *x) { \
+	NAME##NODE *y = x->left; \
+	x->left = y->right; \
+	if(y->right != NULL) \
+		y->right->parent = x; \
+	y->parent = x->parent; \
+	if(x->parent == NULL) \
+		t->root = y; \
+	else if(x == x->parent->right) \
+		x->parent->right = y; \
+	else \
+		x->parent->left = y; \
+	y->right = x; \
+	x->parent = y; \
+} \
+static void NAME##insertionFixup(NAME *t, NAME##NODE *z) { \
+	while(z != t->root && z->parent->color == KTREE_RED) { \
+		NAME##NODE *p = z->parent, *g = p->parent; \
+		NAME##NODE *uncle = p == g->left ? g->right : g->left; \
+		if(NAME##color(uncle) == KTREE_RED) { \
+			p->color = KTREE_BLACK; \
+			uncle->color = KTREE_BLACK; \
+			g->color = KTREE_RED; \
+			z = g; \
+		} else { \
+			if(p == g->left && z == p->right) { \
+				NAME##rotateLeft(t, p); \
+				z = p; \
+				p = z->parent; \
+			} else if(p == g->right && z == p->left) { \
+				NAME##rotateRight(t, p); \
+				z = p; \
+				p = z->parent; \
+			} \
+			p->color = KTREE_BLACK; \
+			g->color = KTREE_RED; \
+			if(p == g->left) \
+				NAME##rotateRight(t, g); \
+			else \
+				NAME##rotateLeft(t, g); \
+		} \
+	} \
+	t->root->color = KTREE_BLACK; \
+} \
+static void NAME##deletionFixup(NAME *t, NAME##NODE *x, NAME##NODE *parent) { \
+	while(x != t->root && NAME##color(x) == KTREE_BLACK) { \
+		if(x == parent->left) { \
+			NAME##NODE *w = parent->right; \
+			if(w->color == KTREE_RED) { \
+				w->color = KTREE_BLACK; \
+				parent->color = KTREE_RED; \
+				NAME##rotateLeft(t, parent); \
+				w = parent->right; \
+			} \
+			if(NAME##color(w->left) == KTREE_BLACK && NAME##color(w->right) == KTREE_BLACK) { \
+				w->color = KTREE_RED; \
+				x = parent; \
+				parent = x->parent; \
+			} else { \
+				if(NAME##color(w->right) == KTREE_BLACK) { \
+					w->left->color = KTREE_BLACK; \
+					w->color = KTREE_RED; \
+					NAME##rotateRight(t, w); \
+					w = parent->right; \
+				} \
+				w->color = parent->color; \
+				parent->color = KTREE_BLACK; \
+				w->right->color = KTREE_BLACK; \
+				NAME##rotateLeft(t, parent); \
+				x = t->root; \
+			} \
+		} else { \
+			NAME##NODE *w = parent->left; \
+			if(w->color == KTREE_RED) { \
+				w->color = KTREE_BLACK; \
+				parent->color = KTREE_RED; \
+				NAME##rotateRight(t, parent); \
+				w = parent->left; \
+			} \
+			if(NAME##color(w->left) == KTREE_BLACK && NAME##color(w->right) == KTREE_BLACK) { \
+				w->color = KTREE_RED; \
+				x = parent; \
+				parent = x->parent; \
+			} else { \
+				if(NAME##color(w->left) == KTREE_BLACK) { \
+					w->right->color = KTREE_BLACK; \
+					w->color = KTREE_RED; \
+					NAME##rotateLeft(t, w); \
+					w = parent->left; \
+				} \
+				w->color = parent->color; \
+				parent->color = KTREE_BLACK; \
+				w->left->color = KTREE_BLACK; \
+				NAME##rotateRight(t, parent); \
+				x = t->root; \
+			} \
+		} \
+	} \
+	if(x != NULL) \
+		x->color = KTREE_BLACK; \
+} \
+\
+void insert##NAME(NAME *t, KEY key) { \
+	NAME##NODE *parent = NULL, *temp = t->root; \
+	int comparison = 0; \
+	while(temp != NULL) { \
+		comparison = CMP(key, temp->key); \
+		if(comparison == 0) { \
+			temp->freq++; \
+			t->words++; \
+			return; \
+		} \
+		parent = temp; \
+		temp = comparison < 0 ? temp->left : temp->right; \
+	} \
+	NAME##NODE *node = malloc(sizeof(NAME##NODE)); \
+	assert(node != 0); \
+	node->key = key; \
+	node->freq = 1; \
+	node->color = KTREE_RED; \
+	node->left = NULL; \
+	node->right = NULL; \
+	node->parent = parent; \
+	if(parent == NULL) \
+		t->root = node; \
+	else if(comparison < 0) \
+		parent->left = node; \
+	else \
+		parent->right = node; \
+	t->size++; \
+	t->words++; \
+	if(BALANCED) \
+		NAME##insertionFixup(t, node); \
+} \
+static NAME##NODE *NAME##findNODE(NAME *t, KEY key) { \
+	NAME##NODE *temp = t->root; \
+	while(temp != NULL) { \
+		int comparison = CMP(key, temp->key); \
+		if(comparison == 0) \
+			return temp; \
+		temp = comparison < 0 ? temp->left : temp->right; \
+	} \
+	return NULL; \
+} \
+int find##NAME(NAME *t, KEY key) { \
+	NAME##NODE *node = NAME##findNODE(t, key); \
+	return node == NULL ? 0 : node->freq; \
+} \
+static void NAME##transplant(NAME *t, NAME##NODE *u, NAME##NODE *v) { \
+	if(u->parent == NULL) \
+		t->root = v; \
+	else if(u == u->parent->left) \
+		u->parent->left = v; \
+	else \
+		u->parent->right = v; \
+	if(v != NULL) \
+		v->parent = u->parent; \
+} \
+int delete##NAME(NAME *t, KEY key) { \
+	NAME##NODE *z = NAME##findNODE(t, key); \
+	if(z == NULL) \
+		return 0; \
+	t->words--; \
+	if(z->freq > 1) { \
+		z->freq--; \
+		return 1; \
+	} \
+	NAME##NODE *x, *parent; \
+	int removedColor = z->color; \
+	if(z->left == NULL) { \
+		x = z->right; \
+		parent = z->parent; \
+		NAME##transplant(t, z, z->right); \
+	} else if(z->right == NULL) { \
+		x = z->left; \
+		parent = z->parent; \
+		NAME##transplant(t, z, z->left); \
+	} else { \
+		NAME##NODE *y = z->right; \
+		while(y->left != NULL) \
+			y = y->left; \
+		removedColor = y->color; \
+		x = y->right; \
+		if(y->parent == z) \
+			parent = y; \
+		else { \
+			parent = y->parent; \
+			NAME##transplant(t, y, y->right); \
+			y->right = z->right; \
+			y->right->parent = y; \
+		} \
+		NAME##transplant(t, z, y); \
+		y->left = z->left; \
+		y->left->parent = y; \
+		y->color = z->color; \
+	} \
+	free(z); \
+	t->size--; \
+	if(BALANCED && removedColor == KTREE_BLACK && t->root != NULL) \
+		NAME##deletionFixup(t, x, parent); \
+	return 1; \
+} \
+int size##NAME(NAME *t) { \
+	return t->size; \
+} \
+int words##NAME(NAME *t) { \
+	return t->words; \
+} \
+void statistics##NAME(FILE *fp, NAME *t) { \
+	int minDepth = 0, maxDepth = 0, depth = 1; \
+	NAME##NODE *node = t->root, *last = NULL; \
+	while(node != NULL) { \
+		NAME##NODE *next; \
+		if(last == node->parent) { \
+			if(depth > maxDepth) \
+				maxDepth = depth; \
+			if((node->left == NULL || node->right == NULL) && (minDepth == 0 || depth < minDepth)) \
+				minDepth = depth; \
+			next = node->left != NULL ? node->left : node->right; \
+		} else if(last == node->left) \
+			next = node->right; \
+		else \
+			next = NULL; \
+		last = node; \
+		if(next != NULL) { \
+			node = next; \
+			depth++; \
+		} else { \
+			node = node->parent; \
+			depth--; \
+		} \
+	} \
+	fprintf(fp, "Words/Phrases: %d\n", t->words); \
+	fprintf(fp, "Nodes: %d\n", t->size); \
+	fprintf(fp, "Minimum depth: %d\n", minDepth); \
+	fprintf(fp, "Maximum depth: %d\n", maxDepth); \
+} \
+void free##NAME(NAME *t) { \
+	NAME##NODE *node = t->root; \
+	while(node != NULL) { \
+		if(node->left != NULL) \
+			node = node->left; \
+		else if(node->right != NULL) \
+			node = node->right; \
+		else { \
+			NAME##NODE *parent = node->parent; \
+			if(parent != NULL && parent->left == node) \
+				parent->left = NULL; \
+			else if(parent != NULL) \
+				parent->right = NULL; \
+			free(node); \
+			node = parent; \
+		} \
+	} \
+	free(t); \
+}
+
+#endif
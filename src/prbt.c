@@ -0,0 +1,399 @@
+#include "prbt.h"
+#include <assert.h>
+#include <stdlib.h>
+#define BLACK 1
+#define RED 0
+
+/*
+ * Contains the implementation for a persistent red-black tree. A snapshot shares
+ * every node with the tree it was taken from, so taking one is O(1), and each
+ * later change copies only the nodes on its own path. Old versions keep seeing
+ * exactly the values and frequencies they had when the snapshot was taken.
+ *
+ * The nodes have no parent pointers, because a node shared between versions can
+ * have a different parent in each. The tree is kept left-leaning (every red node
+ * is a left child), which lets insert and delete restore the balance on the way
+ * back up their recursive descent, where the path copies are made.
+ *
+ * Each node counts the links and versions that refer to it. A node referred to
+ * once, from a node the current version already owns, belongs to that version
+ * alone and is changed in place, so a tree without live snapshots copies
+ * nothing. Nodes are freed when their count drops to zero. The counts are
+ * atomic, so a snapshot may be read and freed on another thread while the tree
+ * it came from keeps changing; each version must still be used by one thread at
+ * a time.
+ */
+
+#ifdef __GNUC__
+#define REFS(n) __atomic_load_n(&(n)->refs, __ATOMIC_ACQUIRE)
+#define RETAIN(n) __atomic_add_fetch(&(n)->refs, 1, __ATOMIC_RELAXED)
+#define DROP(n) __atomic_sub_fetch(&(n)->refs, 1, __ATOMIC_ACQ_REL)
+#else
+#define REFS(n) ((n)->refs)
+#define RETAIN(n) (++(n)->refs)
+#define DROP(n) (--(n)->refs)
+#endif
+
+typedef struct prbtnode {
+	void *value;
+	int freq, color, refs;
+	struct prbtnode *left, *right;
+} PNODE;
+
+struct prbt {
+	PNODE *root;
+	int size, words;
+	void (*display)(FILE *, void *);
+	int (*compare)(void *, void *);
+};
+
+PRBT *newPRBT(void (*d)(FILE *, void *), int (*c)(void *, void *)) {
+	PRBT *t = malloc(sizeof(PRBT));
+	assert(t != 0);
+
+	t->root = NULL;
+	t->size = 0;
+	t->words = 0;
+	t->display = d;
+	t->compare = c;
+	return t;
+}
+/*
+ * Returns a new version that shares all of its nodes with the tree. Either one
+ * may be changed afterwards without the other seeing it. Runs in O(1).
+ */
+PRBT *snapshotPRBT(PRBT *t) {
+	PRBT *s = malloc(sizeof(PRBT));
+	assert(s != 0);
+
+	*s = *t;
+	if(s->root != NULL)
+		RETAIN(s->root);
+	return s;
+}
+
+static PNODE *newPNODE(void *value) {
+	PNODE *n = malloc(sizeof(PNODE));
+	assert(n != 0);
+
+	n->value = value;
+	n->freq = 1;
+	n->color = RED;
+	n->refs = 1;
+	n->left = NULL;
+	n->right = NULL;
+	return n;
+}
+/*
+ * Drops one reference to the node, freeing it and dropping its references to its
+ * children when it was the last.
+ */
+static void release(PNODE *n) {
+	while(n != NULL && DROP(n) == 0) {
+		PNODE *right = n->right;
+		release(n->left);
+		free(n);
+		n = right;
+	}
+}
+/*
+ * Takes the caller's reference to the node and returns a node that only the
+ * caller refers to and may change: the node itself if it was not shared, and
+ * otherwise a copy. The children of a copy gain a reference, so they are shared
+ * in turn and get copied when a change reaches them.
+ */
+static PNODE *own(PNODE *n) {
+	if(REFS(n) == 1)
+		return n;
+	PNODE *copy = malloc(sizeof(PNODE));
+	assert(copy != 0);
+
+	*copy = *n;
+	copy->refs = 1;
+	if(copy->left != NULL)
+		RETAIN(copy->left);
+	if(copy->right != NULL)
+		RETAIN(copy->right);
+	release(n);
+	return copy;
+}
+
+static int isRed(PNODE *n) {
+	return n != NULL && n->color == RED;
+}
+/*
+ * The rotations and color flip expect h to be owned, and take ownership of the
+ * children they change.
+ */
+static PNODE *rotateLeft(PNODE *h) {
+	PNODE *x = own(h->right);
+	h->right = x->left;
+	x->left = h;
+	x->color = h->color;
+	h->color = RED;
+	return x;
+}
+static PNODE *rotateRight(PNODE *h) {
+	PNODE *x = own(h->left);
+	h->left = x->right;
+	x->right = h;
+	x->color = h->color;
+	h->color = RED;
+	return x;
+}
+static void flipColors(PNODE *h) {
+	h->left = own(h->left);
+	h->right = own(h->right);
+	h->color = !h->color;
+	h->left->color = !h->left->color;
+	h->right->color = !h->right->color;
+}
+static PNODE *fixUp(PNODE *h) {
+	if(isRed(h->right) && !isRed(h->left))
+		h = rotateLeft(h);
+	if(isRed(h->left) && isRed(h->left->left))
+		h = rotateRight(h);
+	if(isRed(h->left) && isRed(h->right))
+		flipColors(h);
+	return h;
+}
+
+static PNODE *insertPNODE(PRBT *t, PNODE *h, void *value) {
+	if(h == NULL) {
+		t->size++;
+		return newPNODE(value);
+	}
+	h = own(h);
+	int comparison = t->compare(value, h->value);
+	if(comparison == 0)
+		h->freq++;
+	else if(comparison < 0)
+		h->left = insertPNODE(t, h->left, value);
+	else
+		h->right = insertPNODE(t, h->right, value);
+	return fixUp(h);
+}
+void insertPRBT(PRBT *t, void *value) {
+	t->root = insertPNODE(t, t->root, value);
+	t->root->color = BLACK;
+	t->words++;
+}
+static PNODE *findPNODE(PRBT *t, void *value) {
+	PNODE *n = t->root;
+	while(n != NULL) {
+		int comparison = t->compare(value, n->value);
+		if(comparison == 0)
+			return n;
+		n = comparison < 0 ? n->left : n->right;
+	}
+	return NULL;
+}
+int findPRBT(PRBT *t, void *value) {
+	PNODE *n = findPNODE(t, value);
+	return n == NULL ? 0 : n->freq;
+}
+
+/*
+ * Removing a node follows the usual left-leaning scheme: on the way down the
+ * current node is kept, or made, red or the parent of a red child, so the node
+ * finally removed is a red leaf. Every node touched is owned first.
+ */
+static PNODE *moveRedLeft(PNODE *h) {
+	flipColors(h);
+	if(isRed(h->right->left)) {
+		h->right = rotateRight(h->right);
+		h = rotateLeft(h);
+		flipColors(h);
+	}
+	return h;
+}
+static PNODE *moveRedRight(PNODE *h) {
+	flipColors(h);
+	if(isRed(h->left->left)) {
+		h = rotateRight(h);
+		flipColors(h);
+	}
+	return h;
+}
+static PNODE *deleteMin(PNODE *h) {
+	if(h->left == NULL) {
+		release(h);
+		return NULL;
+	}
+	h = own(h);
+	if(!isRed(h->left) && !isRed(h->left->left))
+		h = moveRedLeft(h);
+	h->left = deleteMin(h->left);
+	return fixUp(h);
+}
+static PNODE *deletePNODE(PRBT *t, PNODE *h, void *value) {
+	h = own(h);
+	if(t->compare(value, h->value) < 0) {
+		if(!isRed(h->left) && !isRed(h->left->left))
+			h = moveRedLeft(h);
+		h->left = deletePNODE(t, h->left, value);
+	} else {
+		if(isRed(h->left))
+			h = rotateRight(h);
+		if(t->compare(value, h->value) == 0 && h->right == NULL) {
+			release(h);
+			return NULL;
+		}
+		if(!isRed(h->right) && !isRed(h->right->left))
+			h = moveRedRight(h);
+		if(t->compare(value, h->value) == 0) {
+			PNODE *min = h->right;
+			while(min->left != NULL)
+				min = min->left;
+			h->value = min->value;
+			h->freq = min->freq;
+			h->right = deleteMin(h->right);
+		} else
+			h->right = deletePNODE(t, h->right, value);
+	}
+	return fixUp(h);
+}
+/*
+ * Lowers the frequency of a value that occurs more than once, copying the path
+ * down to it.
+ */
+static PNODE *decrementPNODE(PRBT *t, PNODE *h, void *value) {
+	h = own(h);
+	int comparison = t->compare(value, h->value);
+	if(comparison == 0)
+		h->freq--;
+	else if(comparison < 0)
+		h->left = decrementPNODE(t, h->left, value);
+	else
+		h->right = decrementPNODE(t, h->right, value);
+	return h;
+}
+/*
+ * Removes one occurrence of the value. Returns 0 if it was not in the tree.
+ */
+int deletePRBT(PRBT *t, void *value) {
+	PNODE *n = findPNODE(t, value);
+	if(n == NULL)
+		return 0;
+	t->words--;
+	if(n->freq > 1) {
+		t->root = decrementPNODE(t, t->root, value);
+		return 1;
+	}
+	t->root = own(t->root);
+	if(!isRed(t->root->left) && !isRed(t->root->right))
+		t->root->color = RED;
+	t->root = deletePNODE(t, t->root, value);
+	if(t->root != NULL)
+		t->root->color = BLACK;
+	t->size--;
+	return 1;
+}
+int sizePRBT(PRBT *t) {
+	return t->size;
+}
+int wordsPRBT(PRBT *t) {
+	return t->words;
+}
+
+static void rangePNODE(PRBT *t, PNODE *n, void *lo, void *hi,
+		void (*visit)(void *, long long, void *), void *arg) {
+	while(n != NULL) {
+		int aboveLo = t->compare(n->value, lo) >= 0;
+		int belowHi = t->compare(n->value, hi) <= 0;
+		if(aboveLo)
+			rangePNODE(t, n->left, lo, hi, visit, arg);
+		if(aboveLo && belowHi)
+			visit(n->value, n->freq, arg);
+		if(!belowHi)
+			return;
+		n = n->right;
+	}
+}
+/*
+ * Visits every value in [lo, hi] in order, passing its frequency along. Runs in
+ * O(log n + k) for k visited values. Scanning a snapshot while its source tree
+ * changes gives the contents at the time of the snapshot.
+ */
+void rangePRBT(PRBT *t, void *lo, void *hi, void (*visit)(void *, long long, void *), void *arg) {
+	rangePNODE(t, t->root, lo, hi, visit, arg);
+}
+
+typedef struct prbtstats {
+	int minDepth, maxDepth, shared;
+	long long depths;
+} STATS;
+static void gatherPNODE(PNODE *n, int depth, STATS *s) {
+	while(n != NULL) {
+		s->depths += depth;
+		if(REFS(n) > 1)
+			s->shared++;
+		if(depth > s->maxDepth)
+			s->maxDepth = depth;
+		if((n->left == NULL || n->right == NULL) && (s->minDepth == 0 || depth < s->minDepth))
+			s->minDepth = depth;
+		gatherPNODE(n->left, depth+1, s);
+		n = n->right;
+		depth++;
+	}
+}
+/*
+ * Prints out the same numbers as statisticsRBT, along with how many nodes are
+ * also referred to by another version.
+ */
+void statisticsPRBT(FILE *fp, PRBT *t) {
+	STATS s = {0, 0, 0, 0};
+	gatherPNODE(t->root, 1, &s);
+	fprintf(fp, "Words/Phrases: %d\n", t->words);
+	fprintf(fp, "Nodes: %d\n", t->size);
+	fprintf(fp, "Minimum depth: %d\n", s.minDepth);
+	fprintf(fp, "Maximum depth: %d\n", s.maxDepth);
+	fprintf(fp, "Average depth: %.2f\n", t->size == 0 ? 0.0 : (double) s.depths / t->size);
+	fprintf(fp, "Shared nodes: %d\n", s.shared);
+}
+/*
+ * Displays the tree level by level in the style of displayRBT. Nodes have no
+ * parents to show, so each is printed with its frequency and color only.
+ */
+void displayPRBT(FILE *fp, PRBT *t) {
+	if(t->root == NULL) {
+		fputs("EMPTY\n", fp);
+		return;
+	}
+	PNODE **nodes = malloc(sizeof(PNODE *) * t->size);
+	assert(nodes != 0);
+	int head = 0, tail = 0, levelEnd = 1, level = 0;
+	nodes[tail++] = t->root;
+
+	fputs("0: ", fp);
+	while(head < tail) {
+		PNODE *n = nodes[head++];
+		if(n->left == NULL && n->right == NULL)
+			fputc('=', fp);
+		t->display(fp, n->value);
+		if(n->freq > 1)
+			fprintf(fp, "-%d", n->freq);
+		fputs(n->color == BLACK ? "-B" : "-R", fp);
+		if(n->left != NULL)
+			nodes[tail++] = n->left;
+		if(n->right != NULL)
+			nodes[tail++] = n->right;
+
+		if(head == tail)
+			fputc('\n', fp);
+		else if(head == levelEnd) {
+			level++;
+			levelEnd = tail;
+			fprintf(fp, "\n%d: ", level);
+		} else
+			fputc(' ', fp);
+	}
+	free(nodes);
+}
+/*
+ * Releases this version. Nodes still used by another version are kept.
+ */
+void freePRBT(PRBT *t) {
+	release(t->root);
+	free(t);
+}
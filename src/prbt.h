@@ -0,0 +1,24 @@
+#ifndef __PRBT_INCLUDED__
+#define __PRBT_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct prbt PRBT;
+
+extern PRBT *newPRBT(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *));           //comparator
+extern PRBT *snapshotPRBT(PRBT *);
+extern void insertPRBT(PRBT *,void *);
+extern int findPRBT(PRBT *,void *);
+extern int deletePRBT(PRBT *,void *);
+extern int sizePRBT(PRBT *);
+extern int wordsPRBT(PRBT *);
+extern void rangePRBT(PRBT *,void *lo,void *hi,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void statisticsPRBT(FILE *,PRBT *);
+extern void displayPRBT(FILE *,PRBT *);
+extern void freePRBT(PRBT *);
+
+#endif
@@ -1,11 +1,18 @@
 #include "rbt.h"
 #include "bst.h"
+#include "da.h"
+#include "sort.h"
+#include "frozen.h"
+#include "snapshot.h"
+#include "bloom.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #define BLACK 1
 #define RED 0
 #define LINEAR 1
 #define NOT_LINEAR 0
+#define FILTER_MINIMUM 1024
 
 /*
  * Written by Zach Wassynger on October 18th, 2017. Contains the implementation for
@@ -16,19 +23,20 @@
 
 typedef struct rbtvalue {
 	void *value;
-	int freq, color;
+	long long freq;
+	int color;
+	int rank;               //position in the top-K heaps, or -1
+	unsigned long long prefix;
 	void (*display)(FILE *, void *);
 	int (*compare)(void *, void *);
 } RBTVALUE;
-static RBTVALUE *newRBTVALUE(void *v, void (*d)(FILE *, void *), int (*c)(void *, void *)) {
+static RBTVALUE keyRBTVALUE(RBT *rbt, void *v);
+static RBTVALUE *newRBTVALUE(RBT *rbt, void *v) {
 	RBTVALUE *p = malloc(sizeof(RBTVALUE));
 	assert(p != 0);
 
-	p->value = v;
+	*p = keyRBTVALUE(rbt, v);
 	p->freq = 1;
-	p->color = 0;
-	p->display = d;
-	p->compare = c;
 	return p;
 }
 static int getColor(BSTNODE *node) {
@@ -52,18 +60,37 @@ static BSTNODE *findNephew(BSTNODE *node);
 static BSTNODE *findNiece(BSTNODE *node);
 static int checkLinear(BSTNODE *parent, BSTNODE *child);
 static void rotate(BST *t, BSTNODE *parent, BSTNODE *child);
-static void rotateLeft(BST *t, BSTNODE *node);
-static void rotateRight(BST *t, BSTNODE *node);
 //static void debugRBTVALUE(BSTNODE *node, char *name);
 static void displayRBTVALUE(FILE *fp, void *v);
 static int compareRBTVALUE(void *x, void *y);
 static void swapRBTVALUE(BSTNODE *x, BSTNODE *y);
+static long long weighRBTVALUE(void *v);
+static void addRBT(RBT *rbt, void *v, long long freq);
+static void rebuildFilter(RBT *rbt);
+static void addFilter(RBT *rbt, void *v);
+static long long removeRBT(RBT *rbt, BSTNODE *node, long long count);
+
+typedef struct rbttop {
+	RBTVALUE **items;       //a min-heap under worseTop
+	RBTVALUE **rest;        //a max-heap of every other value, when tracked
+	int size, capacity, restSize, restCapacity, tracked;
+} TOPK;
+static void enterTop(TOPK *h, RBTVALUE *value);
+static void moveTop(TOPK *h, RBTVALUE *value);
+static void leaveTop(TOPK *h, RBTVALUE *value);
+static void trackTop(RBT *rbt);
 
 struct rbt {
 	BST *tree;
-	int numWords;
+	long long numWords;
 	void (*display)(FILE *, void *);
 	int (*compare)(void *, void *);
+	unsigned long long (*prefix)(void *);
+	BLOOM *filter;
+	unsigned (*hash)(void *);
+	int bitsPerKey, stale;
+	long long filtered, falsePositives;
+	TOPK top;
 };
 
 RBT *newRBT(void (*d)(FILE *, void *), int (*c)(void *, void *)) {
@@ -71,68 +98,1227 @@ RBT *newRBT(void (*d)(FILE *, void *), int (*c)(void *, void *)) {
 	assert(rb != 0);
 
 	rb->tree = newBST(displayRBTVALUE, compareRBTVALUE, swapRBTVALUE);
+	setBSTweight(rb->tree, weighRBTVALUE);
 	rb->numWords = 0;
 	rb->display = d;
 	rb->compare = c;
+	rb->prefix = NULL;
+	rb->filter = NULL;
+	rb->hash = NULL;
+	rb->bitsPerKey = 0;
+	rb->stale = 0;
+	rb->filtered = 0;
+	rb->falsePositives = 0;
+	rb->top.items = NULL;
+	rb->top.rest = NULL;
+	rb->top.size = 0;
+	rb->top.capacity = 0;
+	rb->top.restSize = 0;
+	rb->top.restCapacity = 0;
+	rb->top.tracked = 1;
 	return rb;
 }
-void insertRBT(RBT *rbt, void *v) {
-	RBTVALUE *value = newRBTVALUE(v, rbt->display, rbt->compare);
-	BSTNODE *node = findBST(rbt->tree, value);
+/*
+ * Turns on key-prefix caching. The function maps a value to an integer that
+ * orders values the same way the comparator does, with ties allowed: if
+ * prefix(x) < prefix(y) then x must compare below y. Normalized keys work well,
+ * such as the first 8 bytes of a string packed big-endian. Every RBTVALUE stores
+ * its value's prefix, so most comparisons are settled by one integer compare and
+ * the comparator is only called when two prefixes are equal. May be called on
+ * a tree that already holds values, such as one from buildRBTfromSorted,
+ * mergeRBT or loadRBT: the prefixes of its values are then computed in one
+ * walk, which leaves the order of the nodes as it was. Passing NULL turns the
+ * caching off.
+ */
+void setRBTprefix(RBT *rbt, unsigned long long (*prefix)(void *)) {
+	rbt->prefix = prefix;
+	for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node)) {
+		RBTVALUE *value = getBSTNODE(node);
+		value->prefix = prefix == NULL ? 0 : prefix(value->value);
+	}
+}
+/*
+ * Only the deepest level of a tree built by buildBST is colored red. Every path
+ * from the root then passes the same number of black nodes, and no red node has
+ * a child.
+ */
+static void placeRBTVALUE(BSTNODE *node, int depth, int maxDepth) {
+	setColor(node, depth == maxDepth && depth > 0 ? RED : BLACK);
+}
+/*
+ * Creates a red-black tree from values that are already in sorted order. freqs
+ * may be NULL, in which case every value counts once. Runs of equal values are
+ * merged into one node holding the sum of their frequencies. Runs in linear time
+ * and allocates the nodes and their RBTVALUEs in one block each.
+ */
+RBT *buildRBTfromSorted(void (*d)(FILE *, void *), int (*c)(void *, void *),
+		void **values, long long *freqs, int size) {
+	RBT *rbt = newRBT(d, c);
+	if(size <= 0)
+		return rbt;
+	RBTVALUE *block = malloc(sizeof(RBTVALUE) * size);
+	void **wrapped = malloc(sizeof(void *) * size);
+	assert(block != 0 && wrapped != 0);
+
+	int count = 0;
+	for(int i=0; i<size; i++) {
+		long long freq = freqs == NULL ? 1 : freqs[i];
+		if(count > 0 && c(block[count-1].value, values[i]) == 0)
+			block[count-1].freq += freq;
+		else {
+			assert(count == 0 || c(block[count-1].value, values[i]) < 0);
+			block[count] = keyRBTVALUE(rbt, values[i]);
+			block[count].freq = freq;
+			wrapped[count] = &block[count];
+			count++;
+		}
+		rbt->numWords += freq;
+	}
+	buildBST(rbt->tree, wrapped, count, placeRBTVALUE);
+	free(wrapped);
+	return rbt;
+}
+/*
+ * Creates a red-black tree from the values held in the DA. If threads is positive
+ * the values are sorted first, using up to that many threads. Otherwise they
+ * must already be in sorted order. The DA is left unchanged.
+ */
+RBT *buildRBTfromDA(void (*d)(FILE *, void *), int (*c)(void *, void *), DA *values, int threads) {
+	int size = sizeDA(values);
+	void **sorted = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	assert(sorted != 0);
+	for(int i=0; i<size; i++)
+		sorted[i] = getDA(values, i);
+	if(threads > 0)
+		sortValues(sorted, NULL, size, c, threads);
+	RBT *rbt = buildRBTfromSorted(d, c, sorted, NULL, size);
+	free(sorted);
+	return rbt;
+}
+/*
+ * Creates a balanced tree holding the values of both trees, with the
+ * frequencies of values found in both added together. Walks the two trees in
+ * order side by side and builds the result directly, so it runs in O(n + m).
+ * Both trees are left unchanged and must use the same comparator.
+ */
+RBT *mergeRBT(RBT *a, RBT *b) {
+	int size = sizeRBT(a) + sizeRBT(b);
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+
+	BSTNODE *x = firstRBT(a), *y = firstRBT(b);
+	int count = 0;
+	while(x != NULL || y != NULL) {
+		int comparison;
+		if(x == NULL)
+			comparison = 1;
+		else if(y == NULL)
+			comparison = -1;
+		else
+			comparison = a->compare(getRBTNODEvalue(x), getRBTNODEvalue(y));
+		if(comparison <= 0) {
+			values[count] = getRBTNODEvalue(x);
+			freqs[count] = getRBTNODEfreq(x);
+			if(comparison == 0) {
+				freqs[count] += getRBTNODEfreq(y);
+				y = nextRBT(b, y);
+			}
+			x = nextRBT(a, x);
+		} else {
+			values[count] = getRBTNODEvalue(y);
+			freqs[count] = getRBTNODEfreq(y);
+			y = nextRBT(b, y);
+		}
+		count++;
+	}
+	RBT *merged = buildRBTfromSorted(a->display, a->compare, values, freqs, count);
+	free(values);
+	free(freqs);
+	return merged;
+}
+/*
+ * Adds every value of the donor, with its frequency, into the recipient. Costs
+ * O(m log(n + m)) for a donor of m values, which beats mergeRBT when the donor is
+ * much smaller than the recipient. The donor is left unchanged.
+ */
+void absorbRBT(RBT *recipient, RBT *donor) {
+	for(BSTNODE *node = firstRBT(donor); node != NULL; node = nextRBT(donor, node))
+		addRBT(recipient, getRBTNODEvalue(node), getRBTNODEfreq(node));
+}
+/*
+ * Turns on a Bloom filter in front of the tree, holding every value in it, so
+ * that most finds and deletes of absent values are answered from one cache
+ * line without walking the tree. hash must give equal values equal hashes.
+ * bitsPerKey trades memory for fewer false positives; about 10 gives 1-2%.
+ * Passing a bitsPerKey of 0 turns the filter off. The filter is sized from the
+ * current contents and rebuilt as the tree grows, or once deletes have left
+ * too many stale keys in it.
+ */
+void setRBTfilter(RBT *rbt, unsigned (*hash)(void *), int bitsPerKey) {
+	if(rbt->filter != NULL)
+		freeBLOOM(rbt->filter);
+	rbt->filter = NULL;
+	rbt->hash = hash;
+	rbt->bitsPerKey = bitsPerKey;
+	rbt->filtered = 0;
+	rbt->falsePositives = 0;
+	if(bitsPerKey > 0)
+		rebuildFilter(rbt);
+}
+static void rebuildFilter(RBT *rbt) {
+	if(rbt->bitsPerKey <= 0)
+		return;
+	int capacity = 2 * sizeRBT(rbt);
+	if(capacity < FILTER_MINIMUM)
+		capacity = FILTER_MINIMUM;
+	if(rbt->filter == NULL || capacityBLOOM(rbt->filter) != capacity) {
+		if(rbt->filter != NULL)
+			freeBLOOM(rbt->filter);
+		rbt->filter = newBLOOM(capacity, rbt->bitsPerKey);
+	} else
+		clearBLOOM(rbt->filter);
+	for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node))
+		addBLOOM(rbt->filter, rbt->hash(getRBTNODEvalue(node)));
+	rbt->stale = 0;
+}
+/*
+ * Adds a new value to the filter, or rebuilds the filter once it is full.
+ */
+static void addFilter(RBT *rbt, void *v) {
+	if(rbt->filter == NULL)
+		return;
+	if(keysBLOOM(rbt->filter) < capacityBLOOM(rbt->filter))
+		addBLOOM(rbt->filter, rbt->hash(v));
+	else
+		rebuildFilter(rbt);
+}
+/*
+ * Returns 0 if the filter rules the value out.
+ */
+static int passFilter(RBT *rbt, void *v) {
+	if(rbt->filter == NULL || checkBLOOM(rbt->filter, rbt->hash(v)))
+		return 1;
+	rbt->filtered++;
+	return 0;
+}
+/*
+ * Adds freq occurrences of the value, creating its node if it is new.
+ */
+static void addRBT(RBT *rbt, void *v, long long freq) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	BSTNODE *node = findBST(rbt->tree, &key);
 	if(node == NULL) {
+		RBTVALUE *value = newRBTVALUE(rbt, v);
+		value->freq = freq;
 		node = insertBST(rbt->tree, value);
 		insertionFixup(rbt->tree, node);
+		addFilter(rbt, v);
+		if(rbt->top.items != NULL)
+			enterTop(&rbt->top, value);
 	}
 	else {
 		//If the word is already in the tree
-		value = getBSTNODE(node);
-		value->freq++;
+		RBTVALUE *value = getBSTNODE(node);
+		value->freq += freq;
+		adjustBSTNODEweight(rbt->tree, node, freq);
+		if(rbt->top.items != NULL)
+			moveTop(&rbt->top, value);
 	}
-	rbt->numWords++;
+	rbt->numWords += freq;
+}
+void insertRBT(RBT *rbt, void *v) {
+	addRBT(rbt, v, 1);
 }
-int findRBT(RBT *rbt, void *v) {
-	extern char *getSTRING(void *);
-	RBTVALUE *value = newRBTVALUE(v, rbt->display, rbt->compare);
-	BSTNODE *node = findBST(rbt->tree, value);
+/*
+ * Adds count occurrences of the value at once.
+ */
+void insertRBTcount(RBT *rbt, void *v, long long count) {
+	assert(count > 0);
+	addRBT(rbt, v, count);
+}
+/*
+ * Copies the RBTVALUEs that wrapped points to into a block of their own, sized
+ * to them, and points wrapped at the copies. insertManyRBT collects and sums a
+ * batch in a scratch block, which can then be freed without leaking the slots of
+ * values that were already in the tree or were duplicates.
+ */
+static void keepRBTVALUEs(void **wrapped, int count) {
+	if(count == 0)
+		return;
+	RBTVALUE *kept = malloc(sizeof(RBTVALUE) * count);
+	assert(kept != 0);
+	for(int i=0; i<count; i++) {
+		kept[i] = *(RBTVALUE *) wrapped[i];
+		wrapped[i] = &kept[i];
+	}
+}
+/*
+ * Adds counts[i] occurrences of values[i] for every i in one ordered pass.
+ * counts may be NULL, in which case every value counts once, and entries with a
+ * count of 0 are skipped. The batch is sorted using up to threads threads and
+ * its duplicates summed, then the distinct values are looked up together with
+ * findManyBST. Values already present have their counts raised in place and
+ * the rest are inserted in order, their RBTVALUEs copied into one block sized to
+ * them. An empty tree is instead built balanced in linear time.
+ */
+void insertManyRBT(RBT *rbt, void **values, long long *counts, int size, int threads) {
+	int n = size > 0 ? size : 1;
+	RBTVALUE *block = malloc(sizeof(RBTVALUE) * n);
+	void **wrapped = malloc(sizeof(void *) * n);
+	assert(block != 0 && wrapped != 0);
+
+	int kept = 0;
+	for(int i=0; i<size; i++) {
+		long long count = counts == NULL ? 1 : counts[i];
+		assert(count >= 0);
+		if(count == 0)
+			continue;
+		block[kept] = keyRBTVALUE(rbt, values[i]);
+		block[kept].freq = count;
+		wrapped[kept] = &block[kept];
+		kept++;
+	}
+	sortValues(wrapped, NULL, kept, compareRBTVALUE, threads > 0 ? threads : 1);
+	int distinct = 0;
+	for(int i=0; i<kept; i++) {
+		RBTVALUE *value = wrapped[i];
+		rbt->numWords += value->freq;
+		if(distinct > 0 && compareRBTVALUE(wrapped[distinct-1], value) == 0)
+			((RBTVALUE *) wrapped[distinct-1])->freq += value->freq;
+		else
+			wrapped[distinct++] = value;
+	}
+
+	if(sizeRBT(rbt) == 0) {
+		keepRBTVALUEs(wrapped, distinct);
+		buildBST(rbt->tree, wrapped, distinct, placeRBTVALUE);
+		if(rbt->filter != NULL)
+			rebuildFilter(rbt);
+		if(rbt->top.items != NULL)
+			trackTop(rbt);
+	} else {
+		int inserted = 0;
+		BSTNODE **found = malloc(sizeof(BSTNODE *) * n);
+		assert(found != 0);
+		findManyBST(rbt->tree, wrapped, distinct, found);
+		//The values to insert are packed at the front of wrapped as it is read
+		for(int i=0; i<distinct; i++) {
+			RBTVALUE *value = wrapped[i];
+			if(found[i] == NULL) {
+				wrapped[inserted++] = value;
+				continue;
+			}
+			RBTVALUE *present = getBSTNODE(found[i]);
+			present->freq += value->freq;
+			adjustBSTNODEweight(rbt->tree, found[i], value->freq);
+			if(rbt->top.items != NULL)
+				moveTop(&rbt->top, present);
+		}
+		keepRBTVALUEs(wrapped, inserted);
+		for(int i=0; i<inserted; i++) {
+			BSTNODE *node = insertBST(rbt->tree, wrapped[i]);
+			insertionFixup(rbt->tree, node);
+			addFilter(rbt, ((RBTVALUE *) wrapped[i])->value);
+			if(rbt->top.items != NULL)
+				enterTop(&rbt->top, wrapped[i]);
+		}
+		free(found);
+	}
+	free(block);
+	free(wrapped);
+}
+long long findRBT(RBT *rbt, void *v) {
+	if(!passFilter(rbt, v))
+		return 0;
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	BSTNODE *node = findBST(rbt->tree, &key);
+	if(node == NULL) {
+		if(rbt->filter != NULL)
+			rbt->falsePositives++;
+		return 0;
+	}
+	RBTVALUE *value = getBSTNODE(node);
+	return value->freq;
+}
+/*
+ * Looks up a batch of values with findManyBST, which overlaps the cache misses
+ * of several searches. The frequency of values[i] goes in freqs[i] and its node,
+ * or NULL, in nodes[i]; either array may be NULL. With presort the batch is
+ * searched in sorted order, so consecutive searches share the top of their
+ * paths while it is still in cache.
+ */
+void findManyRBT(RBT *rbt, void **values, int size, long long *freqs, BSTNODE **nodes, int presort) {
+	int n = size > 0 ? size : 1;
+	RBTVALUE *keys = malloc(sizeof(RBTVALUE) * n);
+	void **wrapped = malloc(sizeof(void *) * n);
+	BSTNODE **found = malloc(sizeof(BSTNODE *) * n);
+	int *order = presort ? malloc(sizeof(int) * n) : NULL;
+	assert(keys != 0 && wrapped != 0 && found != 0 && (order != 0 || !presort));
+
+	for(int i=0; i<size; i++) {
+		keys[i] = keyRBTVALUE(rbt, values[i]);
+		wrapped[i] = &keys[i];
+		if(presort)
+			order[i] = i;
+	}
+	if(presort)
+		sortValues(wrapped, order, size, compareRBTVALUE, 1);
+	findManyBST(rbt->tree, wrapped, size, found);
+	for(int i=0; i<size; i++) {
+		int at = presort ? order[i] : i;
+		if(freqs != NULL)
+			freqs[at] = found[i] == NULL ? 0 : getRBTNODEfreq(found[i]);
+		if(nodes != NULL)
+			nodes[at] = found[i];
+	}
+	free(keys);
+	free(wrapped);
+	free(found);
+	free(order);
+}
+/*
+ * Looks up the value like findRBT while another thread may be changing the tree.
+ * Returns -1 if the search gave up after following the given number of links,
+ * otherwise the frequency seen, which the caller must still validate.
+ */
+long long searchRBT(RBT *rbt, void *v, int steps) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	BSTNODE *node;
+	if(searchBST(rbt->tree, &key, steps, &node) == 0)
+		return -1;
 	if(node == NULL)
 		return 0;
-	value = getBSTNODE(node);
+	RBTVALUE *value = getBSTNODE(node);
 	return value->freq;
 }
-void deleteRBT(RBT *rbt, void *v) {
-	RBTVALUE *value = newRBTVALUE(v, rbt->display, rbt->compare);
-	BSTNODE *node = findBST(rbt->tree, value);
-	if(node != NULL) {
-		value = getBSTNODE(node);
-		if(value->freq > 1)
-			value->freq--;
-		else {
-			//When there is only 1 of the phrase - remove node
-			node = swapToLeafBST(rbt->tree, node);
-			deletionFixup(rbt->tree, node);
-			pruneLeafBST(rbt->tree, node);
-		}
-		rbt->numWords--;
+/*
+ * Removes one occurrence of the value. Returns 0 if the value was not in the
+ * tree, and 1 otherwise.
+ */
+int deleteRBT(RBT *rbt, void *v) {
+	return (int) deleteRBTcount(rbt, v, 1);
+}
+/*
+ * Removes up to count occurrences of the value, and the value itself once none
+ * are left. Returns the number removed.
+ */
+long long deleteRBTcount(RBT *rbt, void *v, long long count) {
+	assert(count >= 0);
+	if(count == 0 || !passFilter(rbt, v))
+		return 0;
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	BSTNODE *node = findBST(rbt->tree, &key);
+	if(node == NULL) {
+		if(rbt->filter != NULL)
+			rbt->falsePositives++;
+		return 0;
+	}
+	return removeRBT(rbt, node, count);
+}
+/*
+ * Removes up to count occurrences of the value held by the node, removing the
+ * node too once none are left. Returns the number removed.
+ */
+static long long removeRBT(RBT *rbt, BSTNODE *node, long long count) {
+	RBTVALUE *value = getBSTNODE(node);
+	if(value->freq > count) {
+		value->freq -= count;
+		adjustBSTNODEweight(rbt->tree, node, -count);
+		if(rbt->top.items != NULL)
+			moveTop(&rbt->top, value);
 	} else {
-		printf("Value ");
-		value->display(stdout, value->value);
-		printf(" not found.\n");
+		//When no occurrences are left - remove node
+		count = value->freq;
+		if(rbt->top.items != NULL)
+			leaveTop(&rbt->top, value);
+		node = swapToLeafBST(rbt->tree, node);
+		deletionFixup(rbt->tree, node);
+		pruneLeafBST(rbt->tree, node);
+		//The filter cannot forget the value, so rebuild it once half its keys are gone
+		if(rbt->filter != NULL && ++rbt->stale > keysBLOOM(rbt->filter) / 2)
+			rebuildFilter(rbt);
 	}
+	rbt->numWords -= count;
+	return count;
 }
 int sizeRBT(RBT *rbt) {
 	return sizeBST(rbt->tree);
 }
-int wordsRBT(RBT *rbt) {
+long long wordsRBT(RBT *rbt) {
 	return rbt->numWords;
 }
 void statisticsRBT(FILE *fp, RBT *rbt) {
-	fprintf(fp, "Words/Phrases: %d\n", wordsRBT(rbt));
+	fprintf(fp, "Words/Phrases: %lld\n", wordsRBT(rbt));
 	statisticsBST(fp, rbt->tree);
+	if(rbt->filter != NULL) {
+		long long misses = rbt->filtered + rbt->falsePositives;
+		statisticsBLOOM(fp, rbt->filter);
+		fprintf(fp, "Filtered misses: %lld\n", rbt->filtered);
+		fprintf(fp, "False positive rate: %.2f%%\n",
+			misses == 0 ? 0.0 : 100.0 * rbt->falsePositives / misses);
+	}
 }
 void displayRBT(FILE *fp, RBT *rbt) {
 	displayBST(fp, rbt->tree);
 }
 
+/*
+ * Builds a search key on the stack so that lookups do not allocate.
+ */
+static RBTVALUE keyRBTVALUE(RBT *rbt, void *v) {
+	RBTVALUE key;
+	key.value = v;
+	key.freq = 0;
+	key.color = RED;
+	key.rank = -1;
+	key.prefix = rbt->prefix == NULL ? 0 : rbt->prefix(v);
+	key.display = rbt->display;
+	key.compare = rbt->compare;
+	return key;
+}
+/*
+ * In-order navigation over the nodes of the tree. The nodes returned hold
+ * RBTVALUEs, so getRBTNODEvalue and getRBTNODEfreq should be used to read them.
+ */
+BSTNODE *firstRBT(RBT *rbt) {
+	return firstBST(rbt->tree);
+}
+BSTNODE *lastRBT(RBT *rbt) {
+	return lastBST(rbt->tree);
+}
+BSTNODE *nextRBT(RBT *rbt, BSTNODE *node) {
+	return nextBSTNODE(rbt->tree, node);
+}
+BSTNODE *prevRBT(RBT *rbt, BSTNODE *node) {
+	return prevBSTNODE(rbt->tree, node);
+}
+BSTNODE *lowerBoundRBT(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return lowerBoundBST(rbt->tree, &key);
+}
+BSTNODE *upperBoundRBT(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return upperBoundBST(rbt->tree, &key);
+}
+BSTNODE *floorRBT(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return floorBST(rbt->tree, &key);
+}
+BSTNODE *ceilingRBT(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return ceilingBST(rbt->tree, &key);
+}
+void *getRBTNODEvalue(BSTNODE *node) {
+	RBTVALUE *value = getBSTNODE(node);
+	return value->value;
+}
+long long getRBTNODEfreq(BSTNODE *node) {
+	RBTVALUE *value = getBSTNODE(node);
+	return value->freq;
+}
+/*
+ * Return the smallest and largest values, or NULL if the tree is empty, in
+ * constant time from the nodes cached by the BST.
+ */
+void *minRBT(RBT *rbt) {
+	BSTNODE *node = firstBST(rbt->tree);
+	return node == NULL ? NULL : getRBTNODEvalue(node);
+}
+void *maxRBT(RBT *rbt) {
+	BSTNODE *node = lastBST(rbt->tree);
+	return node == NULL ? NULL : getRBTNODEvalue(node);
+}
+/*
+ * Remove one occurrence of the smallest or largest value and return it, or
+ * return NULL if the tree is empty. No search is needed, and the fixup after
+ * removing a node takes amortized constant time, though the subtree totals
+ * above the node are still updated in O(log n).
+ */
+void *popMinRBT(RBT *rbt) {
+	BSTNODE *node = firstBST(rbt->tree);
+	if(node == NULL)
+		return NULL;
+	void *v = getRBTNODEvalue(node);
+	removeRBT(rbt, node, 1);
+	return v;
+}
+void *popMaxRBT(RBT *rbt) {
+	BSTNODE *node = lastBST(rbt->tree);
+	if(node == NULL)
+		return NULL;
+	void *v = getRBTNODEvalue(node);
+	removeRBT(rbt, node, 1);
+	return v;
+}
+/*
+ * Visits every value in [lo, hi] in order, passing its frequency along. Runs in
+ * O(log n + k) for k visited values.
+ */
+void rangeRBT(RBT *rbt, void *lo, void *hi, void (*visit)(void *, long long, void *), void *arg) {
+	BSTNODE *node = lowerBoundRBT(rbt, lo);
+	while(node != NULL) {
+		RBTVALUE *value = getBSTNODE(node);
+		if(rbt->compare(value->value, hi) > 0)
+			break;
+		visit(value->value, value->freq, arg);
+		node = nextBSTNODE(rbt->tree, node);
+	}
+}
+
+/*
+ * Order statistics over the distinct values, or over every occurrence of them in
+ * the weighted variants. k counts from 0. Each runs in O(log n).
+ */
+void *selectRBT(RBT *rbt, int k) {
+	BSTNODE *node = selectBST(rbt->tree, k);
+	return node == NULL ? NULL : getRBTNODEvalue(node);
+}
+int rankRBT(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return rankBST(rbt->tree, &key);
+}
+void *selectRBTweighted(RBT *rbt, long long k) {
+	BSTNODE *node = selectBSTweighted(rbt->tree, k);
+	return node == NULL ? NULL : getRBTNODEvalue(node);
+}
+long long rankRBTweighted(RBT *rbt, void *v) {
+	RBTVALUE key = keyRBTVALUE(rbt, v);
+	return rankBSTweighted(rbt->tree, &key);
+}
+
+/*
+ * Copies the current contents of the tree into a read-only FROZEN search
+ * structure. Later changes to the tree are not reflected in it.
+ */
+FROZEN *freezeRBT(RBT *rbt) {
+	int size = sizeRBT(rbt), i = 0;
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+	for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node)) {
+		values[i] = getRBTNODEvalue(node);
+		freqs[i] = getRBTNODEfreq(node);
+		i++;
+	}
+	FROZEN *f = newFROZEN(rbt->display, rbt->compare, values, freqs, size);
+	free(values);
+	free(freqs);
+	return f;
+}
+
+/*
+ * Saves the contents of the tree to a binary snapshot at the given path, taking
+ * each value's bytes from the key callback. The file is replaced only once the
+ * new snapshot is complete. Returns 1 on success, 0 if it could not be written.
+ */
+int saveRBT(RBT *rbt, const char *path, const unsigned char *(*key)(void *, int *)) {
+	SNAPWRITER *w = newSNAPWRITER(path);
+	if(w == NULL)
+		return 0;
+	for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node)) {
+		int length;
+		const unsigned char *bytes = key(getRBTNODEvalue(node), &length);
+		writeSNAPWRITER(w, bytes, length, getRBTNODEfreq(node));
+	}
+	return closeSNAPWRITER(w);
+}
+/*
+ * Creates a tree from a snapshot made by saveRBT or saveGT, turning each key
+ * back into a value with the decode callback. The file is checked against its
+ * checksum before any key is decoded, then the records are read in one pass and
+ * the tree is built from them in linear time, already balanced. Returns NULL if
+ * the file cannot be read, is not a snapshot, or fails its checksum.
+ */
+RBT *loadRBT(const char *path, void (*d)(FILE *, void *), int (*c)(void *, void *),
+		void *(*decode)(const unsigned char *, int)) {
+	SNAPREADER *r = newSNAPREADER(path);
+	if(r == NULL)
+		return NULL;
+	int size = sizeSNAPREADER(r);
+	void **values = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	long long *freqs = malloc(sizeof(long long) * (size > 0 ? size : 1));
+	assert(values != 0 && freqs != 0);
+	int i = 0, length;
+	const unsigned char *bytes;
+	while(i < size && (bytes = readSNAPREADER(r, &length, &freqs[i])) != NULL)
+		values[i++] = decode(bytes, length);
+	RBT *rbt = NULL;
+	if(closeSNAPREADER(r))
+		rbt = buildRBTfromSorted(d, c, values, freqs, size);
+	free(values);
+	free(freqs);
+	return rbt;
+}
+
+/*
+ * Top-K by frequency. A TOPK is a min-heap whose root is the worst of the K
+ * values it holds, so a traversal keeps the K most frequent values in O(n log K)
+ * with no allocation beyond the heap. Ties in frequency go to the value that
+ * comes first in the tree, so the answer does not depend on the order in which
+ * the values were counted.
+ *
+ * setRBTtopK also files every other value of the tree in a max-heap, the rest,
+ * whose root is the best value outside the K. Each RBTVALUE's rank says which
+ * heap holds it and where, so a value whose count rises or falls, or that enters
+ * or leaves the tree, is moved within its heap and then at most one value
+ * crosses between the two. Each change costs O(log n) and the K stay exact, so
+ * topKRBT only has to sort them, in O(K log K). A split, join or set operation
+ * rebuilds both heaps in O(n) as it installs its result. The rest costs one
+ * pointer per value.
+ */
+static int worseTop(RBTVALUE *a, RBTVALUE *b) {
+	if(a->freq != b->freq)
+		return a->freq < b->freq;
+	return compareRBTVALUE(a, b) > 0;
+}
+/*
+ * Whether a belongs above b: in the K a parent is worse than its children, in
+ * the rest it is better, so each root is the value nearest the boundary.
+ */
+static int aboveTop(int rest, RBTVALUE *a, RBTVALUE *b) {
+	return rest ? worseTop(b, a) : worseTop(a, b);
+}
+/*
+ * Positions in the rest are recorded as ranks below -1.
+ */
+static void placeTop(TOPK *h, int rest, int i, RBTVALUE *value) {
+	if(rest) {
+		h->rest[i] = value;
+		value->rank = -2 - i;
+	} else {
+		h->items[i] = value;
+		if(h->tracked)
+			value->rank = i;
+	}
+}
+/*
+ * Moves the value at position i down its heap until its children belong below
+ * it.
+ */
+static void sinkTop(TOPK *h, int rest, int i) {
+	RBTVALUE **items = rest ? h->rest : h->items;
+	int size = rest ? h->restSize : h->size;
+	RBTVALUE *value = items[i];
+	while(2 * i + 1 < size) {
+		int child = 2 * i + 1;
+		if(child + 1 < size && aboveTop(rest, items[child + 1], items[child]))
+			child++;
+		if(!aboveTop(rest, items[child], value))
+			break;
+		placeTop(h, rest, i, items[child]);
+		i = child;
+	}
+	placeTop(h, rest, i, value);
+}
+/*
+ * Moves the value at position i up or down its heap to where it belongs.
+ */
+static void siftTop(TOPK *h, int rest, int i) {
+	RBTVALUE **items = rest ? h->rest : h->items;
+	RBTVALUE *value = items[i];
+	while(i > 0 && aboveTop(rest, value, items[(i - 1) / 2])) {
+		placeTop(h, rest, i, items[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	placeTop(h, rest, i, value);
+	sinkTop(h, rest, i);
+}
+static void pushTop(TOPK *h, int rest, RBTVALUE *value) {
+	if(!rest) {
+		placeTop(h, 0, h->size++, value);
+		siftTop(h, 0, h->size - 1);
+		return;
+	}
+	if(h->restSize == h->restCapacity) {
+		h->restCapacity = h->restCapacity > 0 ? 2 * h->restCapacity : 16;
+		h->rest = realloc(h->rest, sizeof(RBTVALUE *) * h->restCapacity);
+		assert(h->rest != 0);
+	}
+	placeTop(h, 1, h->restSize++, value);
+	siftTop(h, 1, h->restSize - 1);
+}
+/*
+ * Takes the value at position i out of one of the heaps and returns it.
+ */
+static RBTVALUE *takeTop(TOPK *h, int rest, int i) {
+	RBTVALUE **items = rest ? h->rest : h->items;
+	int *size = rest ? &h->restSize : &h->size;
+	RBTVALUE *value = items[i];
+	value->rank = -1;
+	if(i < --*size) {
+		placeTop(h, rest, i, items[*size]);
+		siftTop(h, rest, i);
+	}
+	return value;
+}
+/*
+ * Restores the boundary after a single value has changed: the K are only short
+ * when the rest is empty, and their worst beats the best of the rest. One
+ * exchange of the roots is always enough.
+ */
+static void balanceTop(TOPK *h) {
+	if(h->size < h->capacity && h->restSize > 0)
+		pushTop(h, 0, takeTop(h, 1, 0));
+	if(h->size > 0 && h->restSize > 0 && worseTop(h->items[0], h->rest[0])) {
+		RBTVALUE *worst = h->items[0];
+		placeTop(h, 0, 0, h->rest[0]);
+		siftTop(h, 0, 0);
+		placeTop(h, 1, 0, worst);
+		siftTop(h, 1, 0);
+	}
+}
+/*
+ * Files a value that has just entered a tracked tree.
+ */
+static void enterTop(TOPK *h, RBTVALUE *value) {
+	pushTop(h, h->size == h->capacity, value);
+	balanceTop(h);
+}
+/*
+ * Moves a tracked value whose frequency has risen or fallen.
+ */
+static void moveTop(TOPK *h, RBTVALUE *value) {
+	if(value->rank >= 0)
+		siftTop(h, 0, value->rank);
+	else
+		siftTop(h, 1, -2 - value->rank);
+	balanceTop(h);
+}
+/*
+ * Drops a tracked value that is about to leave the tree.
+ */
+static void leaveTop(TOPK *h, RBTVALUE *value) {
+	if(value->rank >= 0)
+		takeTop(h, 0, value->rank);
+	else
+		takeTop(h, 1, -2 - value->rank);
+	balanceTop(h);
+}
+/*
+ * Rebuilds the tracked heaps from the whole tree in O(n + K log n): every value
+ * is heapified into the rest, and the best K are then moved across.
+ */
+static void trackTop(RBT *rbt) {
+	TOPK *h = &rbt->top;
+	int n = sizeRBT(rbt);
+	if(n > h->restCapacity) {
+		h->restCapacity = n;
+		h->rest = realloc(h->rest, sizeof(RBTVALUE *) * n);
+		assert(h->rest != 0);
+	}
+	h->size = 0;
+	h->restSize = 0;
+	for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node))
+		placeTop(h, 1, h->restSize++, getBSTNODE(node));
+	for(int i=h->restSize/2-1; i>=0; i--)
+		sinkTop(h, 1, i);
+	while(h->size < h->capacity && h->restSize > 0)
+		pushTop(h, 0, takeTop(h, 1, 0));
+}
+/*
+ * Offers a value to an untracked heap during a traversal.
+ */
+static void offerTop(TOPK *h, RBTVALUE *value) {
+	if(h->size < h->capacity)
+		pushTop(h, 0, value);
+	else if(h->size > 0 && worseTop(h->items[0], value)) {
+		placeTop(h, 0, 0, value);
+		siftTop(h, 0, 0);
+	}
+}
+static int compareTop(void *x, void *y) {
+	RBTVALUE *p = x, *q = y;
+	return worseTop(q, p) ? -1 : worseTop(p, q) ? 1 : 0;
+}
+/*
+ * Keeps the k most frequent values up to date as the tree changes. A k of 0
+ * stops tracking.
+ */
+void setRBTtopK(RBT *rbt, int k) {
+	assert(k >= 0);
+	free(rbt->top.items);
+	free(rbt->top.rest);
+	rbt->top.items = NULL;
+	rbt->top.rest = NULL;
+	rbt->top.size = 0;
+	rbt->top.restSize = 0;
+	rbt->top.restCapacity = 0;
+	rbt->top.capacity = k;
+	if(k == 0) {
+		for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node))
+			((RBTVALUE *) getBSTNODE(node))->rank = -1;
+		return;
+	}
+	rbt->top.items = malloc(sizeof(RBTVALUE *) * k);
+	assert(rbt->top.items != 0);
+	trackTop(rbt);
+}
+/*
+ * Returns the k most frequent values, most frequent first. If freqs is not NULL
+ * it receives their frequencies. The tracked values answer when there are at
+ * least k of them, in O(k log k); otherwise the tree is traversed.
+ */
+DA *topKRBT(RBT *rbt, int k, long long *freqs) {
+	assert(k >= 0);
+	TOPK local, *h = &rbt->top;
+	if(h->items == NULL || k > h->capacity) {
+		local.items = malloc(sizeof(RBTVALUE *) * (k > 0 ? k : 1));
+		assert(local.items != 0);
+		local.size = 0;
+		local.capacity = k;
+		local.tracked = 0;
+		for(BSTNODE *node = firstRBT(rbt); node != NULL; node = nextRBT(rbt, node))
+			offerTop(&local, getBSTNODE(node));
+		h = &local;
+	}
+
+	int size = h->size;
+	void **sorted = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	assert(sorted != 0);
+	for(int i=0; i<size; i++)
+		sorted[i] = h->items[i];
+	sortValues(sorted, NULL, size, compareTop, 1);
+	DA *result = newDA(rbt->display);
+	for(int i=0; i<size && i<k; i++) {
+		RBTVALUE *value = sorted[i];
+		insertDA(result, value->value);
+		if(freqs != NULL)
+			freqs[i] = value->freq;
+	}
+	free(sorted);
+	if(h == &local)
+		free(local.items);
+	return result;
+}
+
+/*
+ * Join-based split and set operations. They work on detached subtrees, whose
+ * roots point to themselves as their parent like the root of a tree. Each one
+ * is built on join, which links a left tree, a middle node and a right tree
+ * whose values are all below and all above the middle. Join walks down the
+ * spine of the taller tree to a black node of the other's black height, so it
+ * costs the difference in their heights. Union, intersection and difference
+ * then run in O(m log(n/m + 1)) for trees of m <= n values.
+ */
+
+#define PARALLEL_CUTOFF 4096
+#define UNION 0
+#define INTERSECTION 1
+#define DIFFERENCE 2
+
+static BSTNODE *detach(BSTNODE *node) {
+	if(node != NULL)
+		setBSTNODEparent(node, node);
+	return node;
+}
+/*
+ * Makes mid the root of a subtree with the given children, and returns it.
+ */
+static BSTNODE *link(BST *t, BSTNODE *left, BSTNODE *mid, BSTNODE *right) {
+	setBSTNODEleft(mid, left);
+	setBSTNODEright(mid, right);
+	if(left != NULL)
+		setBSTNODEparent(left, mid);
+	if(right != NULL)
+		setBSTNODEparent(right, mid);
+	setBSTNODEparent(mid, mid);
+	updateBSTNODE(t, mid);
+	return mid;
+}
+/*
+ * Returns the black height of the subtree: the black nodes on its left spine,
+ * counting the root if it is black. Only called on whole trees; inside the
+ * recursion the heights are passed along with the subtrees instead.
+ */
+static int blackHeight(BSTNODE *node) {
+	int height = 0;
+	for(; node != NULL; node = getBSTNODEleft(node))
+		if(getColor(node) == BLACK)
+			height++;
+	return height;
+}
+/*
+ * Returns the black height of a child of a node whose black height is h.
+ */
+static int childHeight(BSTNODE *node, int h) {
+	return h - (getColor(node) == BLACK);
+}
+/*
+ * Links k and r into the right spine of l, where l is the taller tree and lh, rh
+ * are the black heights of l and r.
+ */
+static BSTNODE *joinRight(BST *t, BSTNODE *l, int lh, BSTNODE *k, BSTNODE *r, int rh) {
+	if(getColor(l) == BLACK && lh == rh) {
+		setColor(k, RED);
+		return link(t, l, k, r);
+	}
+	BSTNODE *right = joinRight(t, getBSTNODEright(l), childHeight(l, lh), k, r, rh);
+	link(t, getBSTNODEleft(l), l, right);
+	if(getColor(l) == BLACK && getColor(right) == RED && getColor(getBSTNODEright(right)) == RED) {
+		setColor(getBSTNODEright(right), BLACK);
+		return link(t, link(t, getBSTNODEleft(l), l, getBSTNODEleft(right)), right, getBSTNODEright(right));
+	}
+	return l;
+}
+static BSTNODE *joinLeft(BST *t, BSTNODE *l, int lh, BSTNODE *k, BSTNODE *r, int rh) {
+	if(getColor(r) == BLACK && lh == rh) {
+		setColor(k, RED);
+		return link(t, l, k, r);
+	}
+	BSTNODE *left = joinLeft(t, l, lh, k, getBSTNODEleft(r), childHeight(r, rh));
+	link(t, left, r, getBSTNODEright(r));
+	if(getColor(r) == BLACK && getColor(left) == RED && getColor(getBSTNODEleft(left)) == RED) {
+		setColor(getBSTNODEleft(left), BLACK);
+		return link(t, getBSTNODEleft(left), left, link(t, getBSTNODEright(left), r, getBSTNODEright(r)));
+	}
+	return r;
+}
+/*
+ * Joins l, k and r, given the black heights of l and r, and returns the new
+ * subtree with its black height in height. Costs O(|lh - rh| + 1).
+ */
+static BSTNODE *join(BST *t, BSTNODE *l, int lh, BSTNODE *k, BSTNODE *r, int rh, int *height) {
+	//Blackening a red root adds a level
+	if(l != NULL && getColor(l) == RED) {
+		setColor(l, BLACK);
+		lh++;
+	}
+	if(r != NULL && getColor(r) == RED) {
+		setColor(r, BLACK);
+		rh++;
+	}
+	BSTNODE *root;
+	if(lh > rh) {
+		root = joinRight(t, l, lh, k, r, rh);
+		*height = lh;
+		if(getColor(root) == RED && getColor(getBSTNODEright(root)) == RED) {
+			setColor(root, BLACK);
+			++*height;
+		}
+	} else if(rh > lh) {
+		root = joinLeft(t, l, lh, k, r, rh);
+		*height = rh;
+		if(getColor(root) == RED && getColor(getBSTNODEleft(root)) == RED) {
+			setColor(root, BLACK);
+			++*height;
+		}
+	} else {
+		setColor(k, RED);
+		root = link(t, l, k, r);
+		*height = lh;
+	}
+	return root;
+}
+/*
+ * Splits the subtree, of black height h, around the key into the nodes below it
+ * and above it, along with their black heights. The node holding the key, if
+ * any, is returned through found.
+ */
+static void split(RBT *rbt, BSTNODE *node, int h, void *key,
+		BSTNODE **l, int *lh, BSTNODE **found, BSTNODE **r, int *rh) {
+	if(node == NULL) {
+		*l = *found = *r = NULL;
+		*lh = *rh = 0;
+		return;
+	}
+	BSTNODE *left = detach(getBSTNODEleft(node)), *right = detach(getBSTNODEright(node));
+	int below = childHeight(node, h);
+	int comparison = rbt->compare(key, getRBTNODEvalue(node));
+	if(comparison == 0) {
+		*l = left;
+		*lh = below;
+		*found = node;
+		*r = right;
+		*rh = below;
+	} else if(comparison < 0) {
+		BSTNODE *rest;
+		int restHeight;
+		split(rbt, left, below, key, l, lh, found, &rest, &restHeight);
+		*r = join(rbt->tree, rest, restHeight, node, right, below, rh);
+	} else {
+		BSTNODE *rest;
+		int restHeight;
+		split(rbt, right, below, key, &rest, &restHeight, found, r, rh);
+		*l = join(rbt->tree, left, below, node, rest, restHeight, lh);
+	}
+}
+/*
+ * Removes the largest node of the subtree, of black height h, returning it and
+ * leaving the rest of the subtree and its black height in rest and restHeight.
+ */
+static BSTNODE *splitLast(BST *t, BSTNODE *node, int h, BSTNODE **rest, int *restHeight) {
+	BSTNODE *left = detach(getBSTNODEleft(node)), *right = detach(getBSTNODEright(node));
+	int below = childHeight(node, h);
+	if(right == NULL) {
+		*rest = left;
+		*restHeight = below;
+		return node;
+	}
+	BSTNODE *remaining;
+	int remainingHeight;
+	BSTNODE *last = splitLast(t, right, below, &remaining, &remainingHeight);
+	*rest = join(t, left, below, node, remaining, remainingHeight, restHeight);
+	return last;
+}
+/*
+ * Joins two subtrees without a middle node.
+ */
+static BSTNODE *join2(BST *t, BSTNODE *l, int lh, BSTNODE *r, int rh, int *height) {
+	if(l == NULL) {
+		*height = rh;
+		return r;
+	}
+	BSTNODE *rest;
+	int restHeight;
+	BSTNODE *last = splitLast(t, l, lh, &rest, &restHeight);
+	return join(t, rest, restHeight, last, r, rh, height);
+}
+/*
+ * Makes the subtree the whole tree, which takes its size and word count from the
+ * subtree totals.
+ */
+static void install(RBT *rbt, BSTNODE *root) {
+	if(root != NULL)
+		setColor(root, BLACK);
+	setBSTroot(rbt->tree, root);
+	rbt->numWords = root == NULL ? 0 : getBSTNODEweight(root);
+	if(rbt->filter != NULL)
+		rebuildFilter(rbt);
+	if(rbt->top.items != NULL)
+		trackTop(rbt);
+}
+
+/*
+ * Moves every value greater than or equal to the key into a new tree, which is
+ * returned. The new tree keeps the prefix function, whose results its nodes
+ * already hold, and gets its own Bloom filter if the tree has one. Runs in
+ * O(log n), plus the filter rebuilds.
+ */
+RBT *splitRBT(RBT *rbt, void *key) {
+	RBT *upper = newRBT(rbt->display, rbt->compare);
+	upper->prefix = rbt->prefix;
+	upper->hash = rbt->hash;
+	upper->bitsPerKey = rbt->bitsPerKey;
+	BSTNODE *root = detach(getBSTroot(rbt->tree)), *l, *found, *r;
+	int lh, rh;
+	split(rbt, root, blackHeight(root), key, &l, &lh, &found, &r, &rh);
+	if(found != NULL)
+		r = join(rbt->tree, NULL, 0, found, r, rh, &rh);
+	install(rbt, l);
+	install(upper, r);
+	if(upper->bitsPerKey > 0)
+		setRBTfilter(upper, upper->hash, upper->bitsPerKey);
+	return upper;
+}
+/*
+ * Moves every value of right onto the end of left, leaving right empty. Every
+ * value of left must be less than every value of right, and both trees must use
+ * the same prefix function, since the nodes move over with their prefixes.
+ * Runs in O(log n).
+ */
+void joinRBT(RBT *left, RBT *right) {
+	assert(left->prefix == right->prefix);
+	BSTNODE *l = getBSTroot(left->tree), *r = getBSTroot(right->tree);
+	if(l != NULL && r != NULL)
+		assert(left->compare(getRBTNODEvalue(lastRBT(left)), getRBTNODEvalue(firstRBT(right))) < 0);
+	int height;
+	install(left, join2(left->tree, detach(l), blackHeight(l), detach(r), blackHeight(r), &height));
+	install(right, NULL);
+}
+
+typedef struct rbtsetjob {
+	RBT *rbt;
+	BSTNODE *a, *b, *result;
+	int ah, bh, height;             //black heights of a, b and the result
+	int operation, threads;
+} SETJOB;
+/*
+ * Combines the subtrees a and b into job->result. b is exposed at its root and
+ * a is split around the root's value. The two halves are combined recursively,
+ * in parallel when threads allow and b is large enough, then joined back
+ * around the root's node.
+ */
+static void *combine(void *arg) {
+	SETJOB *job = arg;
+	BSTNODE *a = job->a, *b = job->b;
+	if(a == NULL || b == NULL) {
+		if(job->operation == UNION && a == NULL) {
+			job->result = b;
+			job->height = job->bh;
+		} else if(job->operation == INTERSECTION) {
+			job->result = NULL;
+			job->height = 0;
+		} else {
+			job->result = a;
+			job->height = job->ah;
+		}
+		return NULL;
+	}
+	BST *t = job->rbt->tree;
+	int count = getBSTNODEcount(b), below = childHeight(b, job->bh);
+	BSTNODE *above = detach(getBSTNODEright(b)), *under = detach(getBSTNODEleft(b));
+	BSTNODE *l, *found, *r;
+	int lh, rh;
+	split(job->rbt, a, job->ah, getRBTNODEvalue(b), &l, &lh, &found, &r, &rh);
+
+	int leftThreads = job->threads / 2;
+	SETJOB left = {job->rbt, l, under, NULL, lh, below, 0, job->operation, leftThreads};
+	SETJOB right = {job->rbt, r, above, NULL, rh, below, 0, job->operation, job->threads - leftThreads};
+	pthread_t worker;
+	int spawned = 0;
+	if(leftThreads > 0 && count >= PARALLEL_CUTOFF)
+		spawned = pthread_create(&worker, NULL, combine, &left) == 0;
+	if(!spawned)
+		combine(&left);
+	combine(&right);
+	if(spawned)
+		pthread_join(worker, NULL);
+
+	RBTVALUE *value = getBSTNODE(b), *match = found == NULL ? NULL : getBSTNODE(found);
+	if(job->operation == UNION) {
+		if(match != NULL)
+			value->freq += match->freq;
+		job->result = join(t, left.result, left.height, b, right.result, right.height, &job->height);
+	} else if(job->operation == INTERSECTION && match != NULL) {
+		if(value->freq < match->freq)
+			match->freq = value->freq;
+		job->result = join(t, left.result, left.height, found, right.result, right.height, &job->height);
+	} else if(job->operation == DIFFERENCE && match != NULL && match->freq > value->freq) {
+		match->freq -= value->freq;
+		job->result = join(t, left.result, left.height, found, right.result, right.height, &job->height);
+	} else
+		job->result = join2(t, left.result, left.height, right.result, right.height, &job->height);
+	return NULL;
+}
+static void setOperation(RBT *recipient, RBT *donor, int operation, int threads) {
+	//The donor's nodes move into the recipient with their cached prefixes
+	assert(recipient->prefix == donor->prefix);
+	BSTNODE *a = detach(getBSTroot(recipient->tree)), *b = detach(getBSTroot(donor->tree));
+	SETJOB job = {recipient, a, b, NULL, blackHeight(a), blackHeight(b), 0,
+		operation, threads < 1 ? 1 : threads};
+	combine(&job);
+	install(recipient, job.result);
+	install(donor, NULL);
+}
+/*
+ * Multiset operations between two trees with the same comparator and prefix
+ * function. The result replaces the recipient and the donor is left empty.
+ * Union adds frequencies together, intersection keeps the smaller of the two,
+ * and difference takes away the donor's frequency and drops values that reach
+ * zero. threads is the number of threads that may work on the operation at
+ * once; anything below 2 runs on the calling thread.
+ */
+void unionRBT(RBT *recipient, RBT *donor, int threads) {
+	setOperation(recipient, donor, UNION, threads);
+}
+void intersectRBT(RBT *recipient, RBT *donor, int threads) {
+	setOperation(recipient, donor, INTERSECTION, threads);
+}
+void differenceRBT(RBT *recipient, RBT *donor, int threads) {
+	setOperation(recipient, donor, DIFFERENCE, threads);
+}
+
 /*
  * Called after a node is inserted. Follows the "Best Red-Black Tree
  * pseudocode" found on beastie.cs.ua.edu/red-black
@@ -252,41 +1438,9 @@ static int checkLinear(BSTNODE *parent, BSTNODE *child) {
 }
 static void rotate(BST *t, BSTNODE *parent, BSTNODE *child) {
 	if(child == getBSTNODEleft(parent))
-		rotateRight(t, parent);
-	else
-		rotateLeft(t, parent);
-}
-static void rotateLeft(BST *t, BSTNODE *node) {
-	BSTNODE *right = getBSTNODEright(node);
-	setBSTNODEright(node, getBSTNODEleft(right));
-	if(getBSTNODEleft(right) != NULL)
-		setBSTNODEparent(getBSTNODEleft(right), node);
-	setBSTNODEparent(right, getBSTNODEparent(node));
-	if(node == getBSTroot(t)) {
-		setBSTroot(t, right);
-		setBSTNODEparent(right, right);
-	} else if(node == getBSTNODEleft(getBSTNODEparent(node)))
-		setBSTNODEleft(getBSTNODEparent(node), right);
-	else
-		setBSTNODEright(getBSTNODEparent(node), right);
-	setBSTNODEleft(right, node);
-	setBSTNODEparent(node, right);
-}
-static void rotateRight(BST *t, BSTNODE *node) {
-	BSTNODE *left = getBSTNODEleft(node);
-	setBSTNODEleft(node, getBSTNODEright(left));
-	if(getBSTNODEright(left) != NULL)
-		setBSTNODEparent(getBSTNODEright(left), node);
-	setBSTNODEparent(left, getBSTNODEparent(node));
-	if(node == getBSTroot(t)) {
-		setBSTroot(t, left);
-		setBSTNODEparent(left, left);
-	} else if(node == getBSTNODEleft(getBSTNODEparent(node)))
-		setBSTNODEleft(getBSTNODEparent(node), left);
+		rotateRightBST(t, parent);
 	else
-		setBSTNODEright(getBSTNODEparent(node), left);
-	setBSTNODEright(left, node);
-	setBSTNODEparent(node, left);
+		rotateLeftBST(t, parent);
 }
 /*
  * Follows the "Best Red-Black Tree pseudocode" found on beastie.cs.ua.edu/red-black.
@@ -369,28 +1523,33 @@ static void displayRBTVALUE(FILE *fp, void *v) {
 	RBTVALUE *value = v;
 	value->display(fp, value->value);
 	if(value->freq > 1)
-		fprintf(fp, "-%d", value->freq);
+		fprintf(fp, "-%lld", value->freq);
 	if(value->color == BLACK)
 		fprintf(fp, "-B");
 	else
 		fprintf(fp, "-R");
 }
+static long long weighRBTVALUE(void *v) {
+	RBTVALUE *value = v;
+	return value->freq;
+}
 static int compareRBTVALUE(void *x, void *y) {
 	RBTVALUE *p = x, *q = y;
+	if(p->prefix != q->prefix)
+		return p->prefix < q->prefix ? -1 : 1;
 	return p->compare(p->value, q->value);
 }
 /*
- * Swaps the frequency and value of two RBTVALUEs contained in their respective
- * BSTNODEs. Node pointers and color remain unaffected.
+ * Swaps the RBTVALUEs held by two BSTNODEs, then swaps their colors back so
+ * that each node keeps its color. Every RBTVALUE thus stays with its value,
+ * which lets the top-K heaps hold RBTVALUEs across deletes.
  */
 static void swapRBTVALUE(BSTNODE *x, BSTNODE *y) {
 	RBTVALUE *v1 = getBSTNODE(x), *v2 = getBSTNODE(y);
+	setBSTNODE(x, v2);
+	setBSTNODE(y, v1);
 
-	void *tempVal = v1->value;
-	v1->value = v2->value;
-	v2->value = tempVal;
-
-	int tempFreq = v1->freq;
-	v1->freq = v2->freq;
-	v2->freq = tempFreq;
+	int tempColor = v1->color;
+	v1->color = v2->color;
+	v2->color = tempColor;
 }
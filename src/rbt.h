@@ -2,18 +2,78 @@
 #define __RBT_INCLUDED__
 
 #include <stdio.h>
+#include "bst.h"
+#include "da.h"
+#include "frozen.h"
 
 typedef struct rbt RBT;
 
 extern RBT *newRBT(
 	void (*)(FILE *,void *),           //display
 	int (*)(void *,void *));           //comparator
+extern RBT *buildRBTfromSorted(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	void **values,long long *freqs,int size);
+extern RBT *buildRBTfromDA(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	DA *values,int threads);
+extern RBT *mergeRBT(RBT *,RBT *);
+extern void absorbRBT(RBT *recipient,RBT *donor);
+extern void setRBTprefix(RBT *,
+	unsigned long long (*)(void *));   //prefix
+extern void setRBTfilter(RBT *,
+	unsigned (*)(void *),              //hash
+	int bitsPerKey);
 extern void insertRBT(RBT *,void *);
-extern int findRBT(RBT *,void *);
-extern void deleteRBT(RBT *,void *);
+extern void insertRBTcount(RBT *,void *,long long count);
+extern void insertManyRBT(RBT *,void **values,long long *counts,
+	int size,int threads);
+extern long long findRBT(RBT *,void *);
+extern void findManyRBT(RBT *,void **values,int size,
+	long long *freqs,BSTNODE **nodes,int presort);
+extern long long searchRBT(RBT *,void *,int steps);
+extern int deleteRBT(RBT *,void *);
+extern long long deleteRBTcount(RBT *,void *,long long count);
 extern int sizeRBT(RBT *);
-extern int wordsRBT(RBT *);
+extern long long wordsRBT(RBT *);
 extern void statisticsRBT(FILE *,RBT *);
 extern void displayRBT(FILE *,RBT *);
+extern BSTNODE *firstRBT(RBT *);
+extern BSTNODE *lastRBT(RBT *);
+extern BSTNODE *nextRBT(RBT *,BSTNODE *);
+extern BSTNODE *prevRBT(RBT *,BSTNODE *);
+extern BSTNODE *lowerBoundRBT(RBT *,void *);
+extern BSTNODE *upperBoundRBT(RBT *,void *);
+extern BSTNODE *floorRBT(RBT *,void *);
+extern BSTNODE *ceilingRBT(RBT *,void *);
+extern void *getRBTNODEvalue(BSTNODE *);
+extern long long getRBTNODEfreq(BSTNODE *);
+extern void *minRBT(RBT *);
+extern void *maxRBT(RBT *);
+extern void *popMinRBT(RBT *);
+extern void *popMaxRBT(RBT *);
+extern void rangeRBT(RBT *,void *lo,void *hi,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern void *selectRBT(RBT *,int k);
+extern int  rankRBT(RBT *,void *);
+extern void *selectRBTweighted(RBT *,long long k);
+extern long long rankRBTweighted(RBT *,void *);
+extern FROZEN *freezeRBT(RBT *);
+extern int  saveRBT(RBT *,const char *path,
+	const unsigned char *(*)(void *,int *)); //key
+extern RBT *loadRBT(const char *path,
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	void *(*)(const unsigned char *,int)); //decode
+extern void setRBTtopK(RBT *,int k);
+extern DA  *topKRBT(RBT *,int k,long long *freqs);
+extern RBT *splitRBT(RBT *,void *key);
+extern void joinRBT(RBT *left,RBT *right);
+extern void unionRBT(RBT *recipient,RBT *donor,int threads);
+extern void intersectRBT(RBT *recipient,RBT *donor,int threads);
+extern void differenceRBT(RBT *recipient,RBT *donor,int threads);
 
 #endif
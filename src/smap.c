@@ -0,0 +1,308 @@
+#include "smap.h"
+#include "rbt.h"
+#include "gt.h"
+#include "bst.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/*
+ * Contains the implementation for a sharded frequency map. Values are hashed to
+ * one of several independent RBTs or GTs, each behind its own mutex, so threads
+ * inserting different values rarely wait for each other. A value always hashes
+ * to the same shard, so the shards hold disjoint sets of values and a value's
+ * frequency lives in exactly one of them.
+ *
+ * The contents can be walked in order, or merged into a single RBT or GT, with a
+ * k-way merge over in-order walks of the shards.
+ */
+
+#define CACHE_LINE 64
+
+typedef struct smapshard {
+	pthread_mutex_t lock;
+	void *tree;             //an RBT or a GT
+	char pad[CACHE_LINE];   //keeps the next shard's lock off this cache line
+} SHARD;
+
+struct smap {
+	SHARD *shards;
+	int count, kind;
+	void (*display)(FILE *, void *);
+	int (*compare)(void *, void *);
+	unsigned (*hash)(void *);
+};
+
+SMAP *newSMAP(void (*d)(FILE *, void *), int (*c)(void *, void *), unsigned (*h)(void *),
+		int shards, int kind) {
+	assert(shards > 0);
+	assert(kind == SMAP_RBT || kind == SMAP_GT);
+	SMAP *m = malloc(sizeof(SMAP));
+	assert(m != 0);
+
+	m->shards = malloc(sizeof(SHARD) * shards);
+	assert(m->shards != 0);
+	for(int i=0; i<shards; i++) {
+		pthread_mutex_init(&m->shards[i].lock, NULL);
+		m->shards[i].tree = kind == SMAP_RBT ? (void *) newRBT(d, c) : (void *) newGT(d, c);
+	}
+	m->count = shards;
+	m->kind = kind;
+	m->display = d;
+	m->compare = c;
+	m->hash = h;
+	return m;
+}
+
+/*
+ * The hash is mixed before it is scaled to the shard count, so weak hashes that
+ * differ only in their high or low bits still spread over the shards.
+ */
+static int shardOf(SMAP *m, void *value) {
+	unsigned mixed = m->hash(value) * 0x9E3779B1u;
+	return (int) (((unsigned long long) mixed * m->count) >> 32);
+}
+/*
+ * The operations on one shard, which dispatch on the kind of tree the map uses.
+ */
+static void insertShard(SMAP *m, SHARD *s, void *value) {
+	if(m->kind == SMAP_RBT)
+		insertRBT(s->tree, value);
+	else
+		insertGT(s->tree, value);
+}
+static int sizeShard(SMAP *m, SHARD *s) {
+	return m->kind == SMAP_RBT ? sizeRBT(s->tree) : sizeGT(s->tree);
+}
+static long long wordsShard(SMAP *m, SHARD *s) {
+	return m->kind == SMAP_RBT ? wordsRBT(s->tree) : wordsGT(s->tree);
+}
+static BSTNODE *firstShard(SMAP *m, SHARD *s) {
+	return m->kind == SMAP_RBT ? firstRBT(s->tree) : firstGT(s->tree);
+}
+static BSTNODE *nextShard(SMAP *m, SHARD *s, BSTNODE *node) {
+	return m->kind == SMAP_RBT ? nextRBT(s->tree, node) : nextGT(s->tree, node);
+}
+static void *valueOf(SMAP *m, BSTNODE *node) {
+	return m->kind == SMAP_RBT ? getRBTNODEvalue(node) : getGTNODEvalue(node);
+}
+static long long freqOf(SMAP *m, BSTNODE *node) {
+	return m->kind == SMAP_RBT ? getRBTNODEfreq(node) : getGTNODEfreq(node);
+}
+
+void insertSMAP(SMAP *m, void *value) {
+	SHARD *s = &m->shards[shardOf(m, value)];
+	pthread_mutex_lock(&s->lock);
+	insertShard(m, s, value);
+	pthread_mutex_unlock(&s->lock);
+}
+/*
+ * Inserts a batch of values. The batch is grouped by shard first, so each shard
+ * is locked once per batch rather than once per value.
+ */
+void insertManySMAP(SMAP *m, void **values, int size) {
+	int *start = calloc(m->count + 1, sizeof(int));
+	int *shard = malloc(sizeof(int) * (size > 0 ? size : 1));
+	void **grouped = malloc(sizeof(void *) * (size > 0 ? size : 1));
+	assert(start != 0 && shard != 0 && grouped != 0);
+
+	//Counting sort of the batch by shard
+	for(int i=0; i<size; i++) {
+		shard[i] = shardOf(m, values[i]);
+		start[shard[i]+1]++;
+	}
+	for(int i=0; i<m->count; i++)
+		start[i+1] += start[i];
+	for(int i=0; i<size; i++)
+		grouped[start[shard[i]]++] = values[i];
+
+	//start[i] now holds the end of shard i's run
+	int begin = 0;
+	for(int i=0; i<m->count; i++) {
+		if(start[i] == begin)
+			continue;
+		SHARD *s = &m->shards[i];
+		pthread_mutex_lock(&s->lock);
+		for(int j=begin; j<start[i]; j++)
+			insertShard(m, s, grouped[j]);
+		pthread_mutex_unlock(&s->lock);
+		begin = start[i];
+	}
+	free(start);
+	free(shard);
+	free(grouped);
+}
+long long findSMAP(SMAP *m, void *value) {
+	SHARD *s = &m->shards[shardOf(m, value)];
+	pthread_mutex_lock(&s->lock);
+	long long freq = m->kind == SMAP_RBT ? findRBT(s->tree, value) : findGT(s->tree, value);
+	pthread_mutex_unlock(&s->lock);
+	return freq;
+}
+int deleteSMAP(SMAP *m, void *value) {
+	SHARD *s = &m->shards[shardOf(m, value)];
+	pthread_mutex_lock(&s->lock);
+	int deleted = m->kind == SMAP_RBT ? deleteRBT(s->tree, value) : deleteGT(s->tree, value);
+	pthread_mutex_unlock(&s->lock);
+	return deleted;
+}
+/*
+ * The totals are summed shard by shard, so they are exact only while no other
+ * thread is changing the map.
+ */
+int sizeSMAP(SMAP *m) {
+	int size = 0;
+	for(int i=0; i<m->count; i++) {
+		pthread_mutex_lock(&m->shards[i].lock);
+		size += sizeShard(m, &m->shards[i]);
+		pthread_mutex_unlock(&m->shards[i].lock);
+	}
+	return size;
+}
+long long wordsSMAP(SMAP *m) {
+	long long words = 0;
+	for(int i=0; i<m->count; i++) {
+		pthread_mutex_lock(&m->shards[i].lock);
+		words += wordsShard(m, &m->shards[i]);
+		pthread_mutex_unlock(&m->shards[i].lock);
+	}
+	return words;
+}
+
+/*
+ * A min-heap of shard cursors, ordered by the value each one is at.
+ */
+typedef struct smapcursor {
+	BSTNODE *node;
+	SHARD *shard;
+} CURSOR;
+static void siftDown(SMAP *m, CURSOR *heap, int size, int i) {
+	while(1) {
+		int least = i, l = 2*i+1, r = 2*i+2;
+		if(l < size && m->compare(valueOf(m, heap[l].node), valueOf(m, heap[least].node)) < 0)
+			least = l;
+		if(r < size && m->compare(valueOf(m, heap[r].node), valueOf(m, heap[least].node)) < 0)
+			least = r;
+		if(least == i)
+			return;
+		CURSOR temp = heap[i];
+		heap[i] = heap[least];
+		heap[least] = temp;
+		i = least;
+	}
+}
+/*
+ * Visits every value of the map in order, passing its frequency along. All the
+ * shards are locked for the walk, so the visit must not call back into the map.
+ * Runs in O(n log k) for n values over k shards.
+ */
+void walkSMAP(SMAP *m, void (*visit)(void *, long long, void *), void *arg) {
+	CURSOR *heap = malloc(sizeof(CURSOR) * m->count);
+	assert(heap != 0);
+	int size = 0;
+	for(int i=0; i<m->count; i++) {
+		pthread_mutex_lock(&m->shards[i].lock);
+		BSTNODE *first = firstShard(m, &m->shards[i]);
+		if(first != NULL) {
+			heap[size].node = first;
+			heap[size].shard = &m->shards[i];
+			size++;
+		}
+	}
+	for(int i=size/2-1; i>=0; i--)
+		siftDown(m, heap, size, i);
+
+	while(size > 0) {
+		visit(valueOf(m, heap[0].node), freqOf(m, heap[0].node), arg);
+		heap[0].node = nextShard(m, heap[0].shard, heap[0].node);
+		if(heap[0].node == NULL)
+			heap[0] = heap[--size];
+		siftDown(m, heap, size, 0);
+	}
+	for(int i=0; i<m->count; i++)
+		pthread_mutex_unlock(&m->shards[i].lock);
+	free(heap);
+}
+
+typedef struct smapmerge {
+	void **values;
+	long long *freqs;
+	int size, capacity;
+} MERGE;
+static void collect(void *value, long long freq, void *arg) {
+	MERGE *merge = arg;
+	if(merge->size == merge->capacity) {
+		merge->capacity = merge->capacity * 2 + 1;
+		merge->values = realloc(merge->values, sizeof(void *) * merge->capacity);
+		merge->freqs = realloc(merge->freqs, sizeof(long long) * merge->capacity);
+		assert(merge->values != 0 && merge->freqs != 0);
+	}
+	merge->values[merge->size] = value;
+	merge->freqs[merge->size] = freq;
+	merge->size++;
+}
+static MERGE mergeShards(SMAP *m) {
+	MERGE merge;
+	merge.capacity = sizeSMAP(m);
+	merge.size = 0;
+	merge.values = malloc(sizeof(void *) * (merge.capacity > 0 ? merge.capacity : 1));
+	merge.freqs = malloc(sizeof(long long) * (merge.capacity > 0 ? merge.capacity : 1));
+	assert(merge.values != 0 && merge.freqs != 0);
+	walkSMAP(m, collect, &merge);
+	return merge;
+}
+/*
+ * Merges the shards into one balanced RBT or GT holding every value with its
+ * frequency. The map is left unchanged. Runs in O(n log k) for the walk and
+ * O(n) for the build.
+ */
+RBT *mergeSMAPrbt(SMAP *m) {
+	MERGE merge = mergeShards(m);
+	RBT *rbt = buildRBTfromSorted(m->display, m->compare, merge.values, merge.freqs, merge.size);
+	free(merge.values);
+	free(merge.freqs);
+	return rbt;
+}
+GT *mergeSMAPgt(SMAP *m) {
+	MERGE merge = mergeShards(m);
+	GT *gt = buildGTfromSorted(m->display, m->compare, merge.values, merge.freqs, merge.size);
+	free(merge.values);
+	free(merge.freqs);
+	return gt;
+}
+/*
+ * Prints out the totals over all shards and how evenly the values are spread.
+ */
+void statisticsSMAP(FILE *fp, SMAP *m) {
+	long long words = 0;
+	int size = 0, smallest = 0, largest = 0;
+	for(int i=0; i<m->count; i++) {
+		SHARD *s = &m->shards[i];
+		pthread_mutex_lock(&s->lock);
+		int shardSize = sizeShard(m, s);
+		words += wordsShard(m, s);
+		pthread_mutex_unlock(&s->lock);
+		size += shardSize;
+		if(i == 0 || shardSize < smallest)
+			smallest = shardSize;
+		if(shardSize > largest)
+			largest = shardSize;
+	}
+	fprintf(fp, "Words/Phrases: %lld\n", words);
+	fprintf(fp, "Nodes: %d\n", size);
+	fprintf(fp, "Shards: %d\n", m->count);
+	fprintf(fp, "Smallest shard: %d\n", smallest);
+	fprintf(fp, "Largest shard: %d\n", largest);
+}
+void displaySMAP(FILE *fp, SMAP *m) {
+	for(int i=0; i<m->count; i++) {
+		SHARD *s = &m->shards[i];
+		fprintf(fp, "Shard %d:\n", i);
+		pthread_mutex_lock(&s->lock);
+		if(m->kind == SMAP_RBT)
+			displayRBT(fp, s->tree);
+		else
+			displayGT(fp, s->tree);
+		pthread_mutex_unlock(&s->lock);
+	}
+}
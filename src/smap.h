@@ -0,0 +1,33 @@
+#ifndef __SMAP_INCLUDED__
+#define __SMAP_INCLUDED__
+
+#include <stdio.h>
+#include "rbt.h"
+#include "gt.h"
+
+#define SMAP_RBT 0
+#define SMAP_GT 1
+
+typedef struct smap SMAP;
+
+extern SMAP *newSMAP(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	unsigned (*)(void *),              //hash
+	int shards,
+	int kind);                         //SMAP_RBT or SMAP_GT
+extern void insertSMAP(SMAP *,void *);
+extern void insertManySMAP(SMAP *,void **values,int size);
+extern long long findSMAP(SMAP *,void *);
+extern int deleteSMAP(SMAP *,void *);
+extern int sizeSMAP(SMAP *);
+extern long long wordsSMAP(SMAP *);
+extern void walkSMAP(SMAP *,
+	void (*)(void *,long long,void *), //visit(value,freq,arg)
+	void *arg);
+extern RBT *mergeSMAPrbt(SMAP *);
+extern GT *mergeSMAPgt(SMAP *);
+extern void statisticsSMAP(FILE *,SMAP *);
+extern void displaySMAP(FILE *,SMAP *);
+
+#endif
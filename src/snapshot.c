@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+#include "snapshot.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Contains the implementation for binary snapshots of a tree's contents, so a
+ * tree can be saved and reloaded without replaying its inserts. A snapshot file
+ * holds a header, then one record per distinct value in sorted order, then an
+ * index of the records' file offsets:
+ *
+ *     header   magic, version, record count, total frequency, index offset
+ *              and a checksum of everything after the header
+ *     record   8-byte frequency, 8-byte key length, the key bytes, zero padding
+ *              to a multiple of 8
+ *     index    one 8-byte offset per record
+ *
+ * The key bytes come from the caller's key callback, as in the ART, and are
+ * turned back into values by the caller's decode callback on load. Integers are
+ * written in the host's byte order, so a file written on a machine of the other
+ * byte order fails the version check rather than loading garbage.
+ *
+ * A SNAPWRITER streams the records out as the tree is walked and writes them to
+ * a temporary file that is renamed over the target only once it is complete, so
+ * a crash mid-save leaves the previous snapshot in place. A SNAPREADER streams
+ * them back in one pass. A SNAPSHOT instead maps the file and serves read-only
+ * lookups from it, handing out VIEWs of the mapped key bytes, so opening one
+ * costs a scan of the index rather than a rebuild.
+ */
+
+#define MAGIC "TREESNAP"
+#define VERSION 1
+#define BASIS 14695981039346656037ULL   //FNV-1a offset basis
+#define PRIME 1099511628211ULL          //FNV-1a prime
+#define CHUNK 4096                      //index entries read at a time
+
+typedef struct header {
+	char magic[8];
+	unsigned version;
+	unsigned reserved;
+	long long count;
+	long long words;
+	long long index;                //file offset of the index
+	unsigned long long checksum;
+	long long unused[2];
+} HEADER;
+
+struct snapwriter {
+	FILE *fp;
+	char *path, *temporary;
+	long long *index;
+	long long count, capacity, words, offset;
+	unsigned long long checksum;
+	int failed;
+};
+
+struct snapreader {
+	FILE *fp;
+	HEADER header;
+	unsigned char *buffer;
+	long long capacity, read, offset;
+	unsigned long long checksum;
+	int failed;
+};
+
+struct snapshot {
+	const unsigned char *bytes;
+	const long long *index;
+	long long size;
+	HEADER header;
+	int (*compare)(void *, void *);
+	int verified;
+};
+
+/*
+ * Folds n bytes, a multiple of 8, into the checksum a word at a time: FNV-1a
+ * over 64-bit words, with a shift so that high bits reach the low ones.
+ */
+static unsigned long long mix(unsigned long long h, const unsigned char *bytes, long long n) {
+	for(long long i=0; i<n; i+=8) {
+		unsigned long long word;
+		memcpy(&word, bytes + i, 8);
+		h = (h ^ word) * PRIME;
+		h ^= h >> 32;
+	}
+	return h;
+}
+/*
+ * Folds in n bytes of any length, as if they were padded with zeros.
+ */
+static unsigned long long mixPadded(unsigned long long h, const unsigned char *bytes, long long n) {
+	long long whole = n & ~7LL;
+	h = mix(h, bytes, whole);
+	if(whole < n) {
+		unsigned char tail[8] = {0};
+		memcpy(tail, bytes + whole, n - whole);
+		h = mix(h, tail, 8);
+	}
+	return h;
+}
+static long long padded(long long length) {
+	return (length + 7) & ~7LL;
+}
+/*
+ * Checks the header against the size of its file: the records must fit between
+ * the header and the index, and the index must run to the end of the file.
+ */
+static int validHEADER(HEADER *h, long long size) {
+	return memcmp(h->magic, MAGIC, 8) == 0 && h->version == VERSION
+		&& h->count >= 0 && h->count <= INT_MAX
+		&& h->index >= (long long) sizeof(HEADER) && h->index <= size && h->index % 8 == 0
+		&& (size - h->index) % 8 == 0 && (size - h->index) / 8 == h->count;
+}
+
+/*
+ * Starts a snapshot at the given path. Returns NULL if its temporary file cannot
+ * be created.
+ */
+SNAPWRITER *newSNAPWRITER(const char *path) {
+	SNAPWRITER *w = malloc(sizeof(SNAPWRITER));
+	assert(w != 0);
+	w->path = malloc(strlen(path) + 1);
+	w->temporary = malloc(strlen(path) + 5);
+	assert(w->path != 0 && w->temporary != 0);
+	strcpy(w->path, path);
+	strcpy(w->temporary, path);
+	strcat(w->temporary, ".tmp");
+	w->fp = fopen(w->temporary, "wb");
+	if(w->fp == NULL) {
+		free(w->path);
+		free(w->temporary);
+		free(w);
+		return NULL;
+	}
+	//The header is written last, once the checksum is known
+	HEADER blank;
+	memset(&blank, 0, sizeof(HEADER));
+	w->failed = fwrite(&blank, sizeof(HEADER), 1, w->fp) != 1;
+	w->capacity = 1024;
+	w->index = malloc(sizeof(long long) * w->capacity);
+	assert(w->index != 0);
+	w->count = 0;
+	w->words = 0;
+	w->offset = sizeof(HEADER);
+	w->checksum = BASIS;
+	return w;
+}
+/*
+ * Appends a record. The records must be written in sorted order for a SNAPSHOT
+ * to search them.
+ */
+void writeSNAPWRITER(SNAPWRITER *w, const unsigned char *bytes, int length, long long freq) {
+	static const unsigned char zeros[8];
+	assert(length >= 0);
+	if(w->count == w->capacity) {
+		w->capacity *= 2;
+		w->index = realloc(w->index, sizeof(long long) * w->capacity);
+		assert(w->index != 0);
+	}
+	w->index[w->count++] = w->offset;
+	long long head[2] = {freq, length};
+	long long pad = padded(length) - length;
+	if(fwrite(head, sizeof(head), 1, w->fp) != 1
+			|| (length > 0 && fwrite(bytes, length, 1, w->fp) != 1)
+			|| (pad > 0 && fwrite(zeros, pad, 1, w->fp) != 1))
+		w->failed = 1;
+	w->checksum = mix(w->checksum, (const unsigned char *) head, sizeof(head));
+	w->checksum = mixPadded(w->checksum, bytes, length);
+	w->offset += sizeof(head) + padded(length);
+	w->words += freq;
+}
+/*
+ * Writes the index and the header and moves the finished file over the target.
+ * Returns 1 on success. On failure the target is left untouched and the
+ * temporary file is removed.
+ */
+int closeSNAPWRITER(SNAPWRITER *w) {
+	if(w->count > 0 && fwrite(w->index, sizeof(long long) * w->count, 1, w->fp) != 1)
+		w->failed = 1;
+	w->checksum = mix(w->checksum, (const unsigned char *) w->index, sizeof(long long) * w->count);
+
+	HEADER h;
+	memset(&h, 0, sizeof(HEADER));
+	memcpy(h.magic, MAGIC, 8);
+	h.version = VERSION;
+	h.count = w->count;
+	h.words = w->words;
+	h.index = w->offset;
+	h.checksum = w->checksum;
+	if(fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(HEADER), 1, w->fp) != 1)
+		w->failed = 1;
+	if(fclose(w->fp) != 0)
+		w->failed = 1;
+	if(!w->failed && rename(w->temporary, w->path) != 0)
+		w->failed = 1;
+	if(w->failed)
+		remove(w->temporary);
+
+	int ok = !w->failed;
+	free(w->index);
+	free(w->path);
+	free(w->temporary);
+	free(w);
+	return ok;
+}
+
+/*
+ * Opens a snapshot for one streaming pass over its records. The rest of the file
+ * is first read through once and checked against the header's checksum, so a
+ * damaged snapshot is refused before the caller decodes any of its keys; both
+ * passes use the same open file, so a save that replaces it meanwhile does not
+ * matter. Returns NULL if the file cannot be opened, its header is not that of
+ * a snapshot of this version, or it fails the checksum.
+ */
+SNAPREADER *newSNAPREADER(const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL)
+		return NULL;
+	struct stat st;
+	HEADER h;
+	if(fstat(fileno(fp), &st) != 0 || fread(&h, sizeof(HEADER), 1, fp) != 1
+			|| !validHEADER(&h, st.st_size)) {
+		fclose(fp);
+		return NULL;
+	}
+	SNAPREADER *r = malloc(sizeof(SNAPREADER));
+	assert(r != 0);
+	r->fp = fp;
+	r->header = h;
+	r->capacity = sizeof(long long) * CHUNK;
+	r->buffer = malloc(r->capacity);
+	assert(r->buffer != 0);
+
+	//The body is a whole number of 8-byte words, and so is every chunk
+	unsigned long long checksum = BASIS;
+	long long left = st.st_size - sizeof(HEADER);
+	while(left > 0) {
+		long long n = left < r->capacity ? left : r->capacity;
+		if(fread(r->buffer, n, 1, fp) != 1)
+			break;
+		checksum = mix(checksum, r->buffer, n);
+		left -= n;
+	}
+	if(left > 0 || checksum != h.checksum || fseek(fp, sizeof(HEADER), SEEK_SET) != 0) {
+		fclose(fp);
+		free(r->buffer);
+		free(r);
+		return NULL;
+	}
+	r->read = 0;
+	r->offset = sizeof(HEADER);
+	r->checksum = BASIS;
+	r->failed = 0;
+	return r;
+}
+int sizeSNAPREADER(SNAPREADER *r) {
+	return r->header.count;
+}
+/*
+ * Returns the key bytes of the next record, setting its length and frequency, or
+ * NULL after the last record or if the file is damaged. The bytes are
+ * overwritten by the next read.
+ */
+const unsigned char *readSNAPREADER(SNAPREADER *r, int *length, long long *freq) {
+	if(r->failed || r->read == r->header.count)
+		return NULL;
+	long long head[2];
+	if(fread(head, sizeof(head), 1, r->fp) != 1 || head[1] < 0 || head[1] > INT_MAX
+			|| r->offset + (long long) sizeof(head) + padded(head[1]) > r->header.index) {
+		r->failed = 1;
+		return NULL;
+	}
+	long long n = padded(head[1]);
+	if(n > r->capacity) {
+		while(r->capacity < n)
+			r->capacity *= 2;
+		r->buffer = realloc(r->buffer, r->capacity);
+		assert(r->buffer != 0);
+	}
+	if(n > 0 && fread(r->buffer, n, 1, r->fp) != 1) {
+		r->failed = 1;
+		return NULL;
+	}
+	r->checksum = mix(r->checksum, (const unsigned char *) head, sizeof(head));
+	r->checksum = mix(r->checksum, r->buffer, n);
+	r->offset += sizeof(head) + n;
+	r->read++;
+	*length = head[1];
+	*freq = head[0];
+	return r->buffer;
+}
+/*
+ * Finishes the pass, folding the index into the checksum. Returns 1 if every
+ * record was read and the checksum still matches, 0 if the file was damaged or
+ * changed in place after it was opened.
+ */
+int closeSNAPREADER(SNAPREADER *r) {
+	int ok = !r->failed && r->read == r->header.count && r->offset == r->header.index;
+	long long chunk[CHUNK];
+	for(long long i=0; ok && i<r->header.count; i+=CHUNK) {
+		long long n = r->header.count - i < CHUNK ? r->header.count - i : CHUNK;
+		if(fread(chunk, sizeof(long long) * n, 1, r->fp) != 1)
+			ok = 0;
+		else
+			r->checksum = mix(r->checksum, (const unsigned char *) chunk, sizeof(long long) * n);
+	}
+	ok = ok && r->checksum == r->header.checksum;
+	fclose(r->fp);
+	free(r->buffer);
+	free(r);
+	return ok;
+}
+
+/*
+ * Maps a snapshot read-only for lookups. The comparator is called with two
+ * VIEWs, the first of the mapped key bytes, and must order them as the tree that
+ * was saved ordered its values(compareVIEW for a tree of VIEWs or strings saved
+ * with their bytes). The index is always checked; if verify is set, the
+ * checksum is checked too, which reads the whole file. Returns NULL if the file
+ * cannot be mapped or fails the checks.
+ */
+SNAPSHOT *openSNAPSHOT(const char *path, int (*c)(void *, void *), int verify) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < (long long) sizeof(HEADER)) {
+		close(fd);
+		return NULL;
+	}
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//The mapping outlives the descriptor
+	close(fd);
+	if(p == MAP_FAILED)
+		return NULL;
+
+	SNAPSHOT *s = malloc(sizeof(SNAPSHOT));
+	assert(s != 0);
+	s->bytes = p;
+	s->size = st.st_size;
+	memcpy(&s->header, s->bytes, sizeof(HEADER));
+	s->compare = c;
+	s->verified = verify;
+	int ok = validHEADER(&s->header, s->size);
+	if(ok) {
+		//The records are 8-byte aligned in the file, so the index is too
+		s->index = (const long long *) (s->bytes + s->header.index);
+		long long previous = sizeof(HEADER) - 16;
+		for(long long i=0; ok && i<s->header.count; i++) {
+			ok = s->index[i] >= previous + 16 && s->index[i] % 8 == 0;
+			previous = s->index[i];
+		}
+		ok = ok && (s->header.count == 0 || previous + 16 <= s->header.index);
+	}
+	if(ok && verify)
+		ok = mix(BASIS, s->bytes + sizeof(HEADER), s->size - sizeof(HEADER)) == s->header.checksum;
+	if(!ok) {
+		munmap(p, s->size);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+/*
+ * Points the view at the key bytes of the i-th record and returns its frequency.
+ * A damaged length is cut short at the next record instead of running past it.
+ */
+static long long recordSNAPSHOT(SNAPSHOT *s, int i, VIEW *view) {
+	const long long *head = (const long long *) (s->bytes + s->index[i]);
+	long long end = i + 1 < s->header.count ? s->index[i+1] : s->header.index;
+	long long room = end - s->index[i] - 16, length = head[1];
+	if(length < 0 || length > room)
+		length = length < 0 ? 0 : room;
+	view->bytes = (const unsigned char *) (head + 2);
+	view->length = length;
+	view->source = NULL;
+	return head[0];
+}
+/*
+ * Returns the position of the first record not less than the key, or the size
+ * when every record is less.
+ */
+static int lowerBoundSNAPSHOT(SNAPSHOT *s, VIEW *key) {
+	int lo = 0, hi = s->header.count;
+	while(lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		VIEW view;
+		recordSNAPSHOT(s, mid, &view);
+		if(s->compare(&view, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+/*
+ * Returns the frequency of the key, or 0 if it is not present.
+ */
+long long findSNAPSHOT(SNAPSHOT *s, VIEW *key) {
+	int i = lowerBoundSNAPSHOT(s, key);
+	if(i == s->header.count)
+		return 0;
+	VIEW view;
+	long long freq = recordSNAPSHOT(s, i, &view);
+	return s->compare(&view, key) == 0 ? freq : 0;
+}
+/*
+ * Returns the number of distinct keys less than the given key.
+ */
+int rankSNAPSHOT(SNAPSHOT *s, VIEW *key) {
+	return lowerBoundSNAPSHOT(s, key);
+}
+/*
+ * Points the view at the k-th smallest key, counting from 0, and returns its
+ * frequency, or returns 0 and leaves the view alone if k is out of range. The
+ * view holds no reference and is valid until the snapshot is freed.
+ */
+long long selectSNAPSHOT(SNAPSHOT *s, int k, VIEW *view) {
+	if(k < 0 || k >= s->header.count)
+		return 0;
+	return recordSNAPSHOT(s, k, view);
+}
+/*
+ * Visits a VIEW of every key in [lo, hi] in order, passing its frequency along.
+ * The VIEW lives on the stack, as in tokensMAPPING.
+ */
+void rangeSNAPSHOT(SNAPSHOT *s, VIEW *lo, VIEW *hi, void (*visit)(void *, long long, void *), void *arg) {
+	for(int i=lowerBoundSNAPSHOT(s, lo); i<s->header.count; i++) {
+		VIEW view;
+		long long freq = recordSNAPSHOT(s, i, &view);
+		if(s->compare(&view, hi) > 0)
+			break;
+		visit(&view, freq, arg);
+	}
+}
+int sizeSNAPSHOT(SNAPSHOT *s) {
+	return s->header.count;
+}
+long long wordsSNAPSHOT(SNAPSHOT *s) {
+	return s->header.words;
+}
+void statisticsSNAPSHOT(FILE *fp, SNAPSHOT *s) {
+	fprintf(fp, "Snapshot records: %lld\n", s->header.count);
+	fprintf(fp, "Words: %lld\n", s->header.words);
+	fprintf(fp, "File size: %lld bytes(%lld in keys and frequencies)\n", s->size,
+		s->header.index - (long long) sizeof(HEADER));
+	fprintf(fp, "Checksum verified: %s\n", s->verified ? "yes" : "no");
+}
+/*
+ * Unmaps the file. Views handed out by the snapshot must not be used afterwards.
+ */
+void freeSNAPSHOT(SNAPSHOT *s) {
+	munmap((void *) s->bytes, s->size);
+	free(s);
+}
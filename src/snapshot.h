@@ -0,0 +1,34 @@
+#ifndef __SNAPSHOT_INCLUDED__
+#define __SNAPSHOT_INCLUDED__
+
+#include <stdio.h>
+#include "view.h"
+
+typedef struct snapshot SNAPSHOT;
+typedef struct snapwriter SNAPWRITER;
+typedef struct snapreader SNAPREADER;
+
+extern SNAPWRITER *newSNAPWRITER(const char *path);
+extern void writeSNAPWRITER(SNAPWRITER *,const unsigned char *bytes,int length,long long freq);
+extern int  closeSNAPWRITER(SNAPWRITER *);
+
+extern SNAPREADER *newSNAPREADER(const char *path);
+extern int  sizeSNAPREADER(SNAPREADER *);
+extern const unsigned char *readSNAPREADER(SNAPREADER *,int *length,long long *freq);
+extern int  closeSNAPREADER(SNAPREADER *);
+
+extern SNAPSHOT *openSNAPSHOT(const char *path,
+	int (*)(void *,void *),            //comparator over VIEWs
+	int verify);
+extern long long findSNAPSHOT(SNAPSHOT *,VIEW *);
+extern int  rankSNAPSHOT(SNAPSHOT *,VIEW *);
+extern long long selectSNAPSHOT(SNAPSHOT *,int k,VIEW *);
+extern void rangeSNAPSHOT(SNAPSHOT *,VIEW *lo,VIEW *hi,
+	void (*)(void *,long long,void *), //visit(view,freq,arg)
+	void *arg);
+extern int  sizeSNAPSHOT(SNAPSHOT *);
+extern long long wordsSNAPSHOT(SNAPSHOT *);
+extern void statisticsSNAPSHOT(FILE *,SNAPSHOT *);
+extern void freeSNAPSHOT(SNAPSHOT *);
+
+#endif
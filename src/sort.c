@@ -0,0 +1,125 @@
+#include "sort.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Contains a stable merge sort for arrays of generic values. An optional array
+ * of frequencies is permuted along with the values. When more than one thread
+ * is given, the two halves of each large enough range are sorted in parallel.
+ */
+
+#define INSERTION_CUTOFF 32
+#define PARALLEL_CUTOFF 16384
+
+typedef struct sortjob {
+	void **values, **scratch;
+	int *freqs, *freqScratch;
+	int size, threads;
+	int (*compare)(void *, void *);
+} SORTJOB;
+
+static void insertionSort(SORTJOB *job) {
+	for(int i=1; i<job->size; i++) {
+		void *value = job->values[i];
+		int freq = job->freqs == NULL ? 0 : job->freqs[i];
+		int j = i-1;
+		while(j >= 0 && job->compare(job->values[j], value) > 0) {
+			job->values[j+1] = job->values[j];
+			if(job->freqs != NULL)
+				job->freqs[j+1] = job->freqs[j];
+			j--;
+		}
+		job->values[j+1] = value;
+		if(job->freqs != NULL)
+			job->freqs[j+1] = freq;
+	}
+}
+/*
+ * Merges the two sorted halves of the job through its scratch space.
+ */
+static void merge(SORTJOB *job, int half) {
+	int i = 0, j = half, k = 0;
+	while(i < half || j < job->size) {
+		int fromLeft;
+		if(i == half)
+			fromLeft = 0;
+		else if(j == job->size)
+			fromLeft = 1;
+		else
+			fromLeft = job->compare(job->values[j], job->values[i]) >= 0;
+		int from = fromLeft ? i++ : j++;
+		job->scratch[k] = job->values[from];
+		if(job->freqs != NULL)
+			job->freqScratch[k] = job->freqs[from];
+		k++;
+	}
+	memcpy(job->values, job->scratch, sizeof(void *) * job->size);
+	if(job->freqs != NULL)
+		memcpy(job->freqs, job->freqScratch, sizeof(int) * job->size);
+}
+static SORTJOB subJob(SORTJOB *job, int offset, int size, int threads) {
+	SORTJOB sub = *job;
+	sub.values += offset;
+	sub.scratch += offset;
+	if(job->freqs != NULL) {
+		sub.freqs += offset;
+		sub.freqScratch += offset;
+	}
+	sub.size = size;
+	sub.threads = threads;
+	return sub;
+}
+static void *mergeSort(void *arg) {
+	SORTJOB *job = arg;
+	if(job->size <= INSERTION_CUTOFF) {
+		insertionSort(job);
+		return NULL;
+	}
+	int half = job->size / 2;
+	int leftThreads = job->threads / 2;
+	SORTJOB left = subJob(job, 0, half, leftThreads);
+	SORTJOB right = subJob(job, half, job->size - half, job->threads - leftThreads);
+
+	pthread_t worker;
+	int spawned = 0;
+	if(leftThreads > 0 && job->size >= PARALLEL_CUTOFF)
+		spawned = pthread_create(&worker, NULL, mergeSort, &left) == 0;
+	if(!spawned)
+		mergeSort(&left);
+	mergeSort(&right);
+	if(spawned)
+		pthread_join(worker, NULL);
+
+	merge(job, half);
+	return NULL;
+}
+
+/*
+ * Sorts the values with the comparator, moving each frequency along with its
+ * value. freqs may be NULL. threads is the number of threads that may work on
+ * the sort at once; anything below 2 sorts on the calling thread.
+ */
+void sortValues(void **values, int *freqs, int size, int (*c)(void *, void *), int threads) {
+	if(size < 2)
+		return;
+	SORTJOB job;
+	job.values = values;
+	job.freqs = freqs;
+	job.size = size;
+	job.threads = threads < 1 ? 1 : threads;
+	job.compare = c;
+	job.scratch = malloc(sizeof(void *) * size);
+	assert(job.scratch != 0);
+	job.freqScratch = NULL;
+	if(freqs != NULL) {
+		job.freqScratch = malloc(sizeof(int) * size);
+		assert(job.freqScratch != 0);
+	}
+
+	mergeSort(&job);
+
+	free(job.scratch);
+	free(job.freqScratch);
+}
@@ -0,0 +1,8 @@
+#ifndef __SORT_INCLUDED__
+#define __SORT_INCLUDED__
+
+extern void sortValues(void **values,int *freqs,int size,
+	int (*)(void *,void *),            //comparator
+	int threads);
+
+#endif
@@ -0,0 +1,190 @@
+#include "spt.h"
+#include "bst.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Contains the implementation for a splay tree, a self-adjusting BST that moves
+ * every value it touches up to the root with the BST's rotations. Frequently
+ * used values stay near the top, so skewed workloads find them in few steps.
+ * Like the GT, each distinct value is stored once along with its frequency, in
+ * an SPTVALUE.
+ *
+ * With SPT_SEMISPLAY only half of each zig-zig step is done, which moves a value
+ * about halfway to the root with fewer rotations. With SPT_FIND_ONLY the tree is
+ * only restructured by finds, so inserts and deletes cost a plain BST walk.
+ *
+ * The rotations are paid on every access, so when accesses are spread evenly a
+ * splay tree loses to the balanced trees: 2e6 uniform finds over 2e5 keys took
+ * about 8s splaying and 6.4s semi-splaying, against 3.7s for the RBT.
+ */
+
+typedef struct sptvalue {
+	void *value;
+	long long freq;
+	void (*display)(FILE *,void *);
+	int (*compare)(void *,void *);
+} SPTVALUE;
+static SPTVALUE *newSPTVALUE(void *value,
+		void (*d)(FILE *,void *), int (*c)(void *,void *)) {
+	SPTVALUE *p = malloc(sizeof(SPTVALUE));
+	assert(p != 0);
+
+	p->value = value;
+	p->freq = 1;
+	p->display = d;
+	p->compare = c;
+	return p;
+}
+
+struct spt {
+	BST *tree;
+	long long numWords;
+	int flags;
+	void (*display)(FILE *,void *);
+	int (*compare)(void *,void *);
+};
+
+static void displaySPTVALUE(FILE *fp, void *value);
+static int compareSPTVALUE(void *x, void *y);
+static long long weighSPTVALUE(void *value);
+static SPTVALUE keySPTVALUE(SPT *spt, void *value);
+static void splay(SPT *spt, BSTNODE *node);
+
+SPT *newSPT(void (*d)(FILE *,void *), int (*c)(void *,void *), int flags) {
+	SPT *p = malloc(sizeof(SPT));
+	assert(p != 0);
+
+	p->tree = newBST(displaySPTVALUE, compareSPTVALUE, NULL);
+	setBSTweight(p->tree, weighSPTVALUE);
+	p->numWords = 0;
+	p->flags = flags;
+	p->display = d;
+	p->compare = c;
+	return p;
+}
+void insertSPT(SPT *spt, void *value) {
+	SPTVALUE key = keySPTVALUE(spt, value);
+	BSTNODE *node = findBST(spt->tree, &key);
+	if(node == NULL)
+		node = insertBST(spt->tree, newSPTVALUE(value, spt->display, spt->compare));
+	else {
+		SPTVALUE *v = getBSTNODE(node);
+		v->freq++;
+		adjustBSTNODEweight(spt->tree, node, 1);
+	}
+	spt->numWords++;
+	if(!(spt->flags & SPT_FIND_ONLY))
+		splay(spt, node);
+}
+/*
+ * Returns the frequency of the value, or 0 if it is not in the tree. A value that
+ * is found is splayed towards the root.
+ */
+long long findSPT(SPT *spt, void *value) {
+	SPTVALUE key = keySPTVALUE(spt, value);
+	BSTNODE *node = findBST(spt->tree, &key);
+	if(node == NULL)
+		return 0;
+	splay(spt, node);
+	SPTVALUE *v = getBSTNODE(node);
+	return v->freq;
+}
+/*
+ * Removes one occurrence of the value. Returns 1 if it was found and 0 otherwise.
+ * When the last occurrence goes, the parent of the pruned leaf is splayed.
+ */
+int deleteSPT(SPT *spt, void *value) {
+	SPTVALUE key = keySPTVALUE(spt, value);
+	BSTNODE *node = findBST(spt->tree, &key);
+	if(node == NULL)
+		return 0;
+	SPTVALUE *v = getBSTNODE(node);
+	spt->numWords--;
+	if(v->freq > 1) {
+		v->freq--;
+		adjustBSTNODEweight(spt->tree, node, -1);
+		if(!(spt->flags & SPT_FIND_ONLY))
+			splay(spt, node);
+		return 1;
+	}
+	BSTNODE *leaf = swapToLeafBST(spt->tree, node);
+	BSTNODE *parent = leaf == getBSTroot(spt->tree) ? NULL : getBSTNODEparent(leaf);
+	pruneLeafBST(spt->tree, leaf);
+	if(parent != NULL && !(spt->flags & SPT_FIND_ONLY))
+		splay(spt, parent);
+	return 1;
+}
+int sizeSPT(SPT *spt) {
+	return sizeBST(spt->tree);
+}
+long long wordsSPT(SPT *spt) {
+	return spt->numWords;
+}
+void statisticsSPT(FILE *fp, SPT *spt) {
+	fprintf(fp, "Words/Phrases: %lld\n", wordsSPT(spt));
+	statisticsBST(fp, spt->tree);
+}
+void displaySPT(FILE *fp, SPT *spt) {
+	displayBST(fp, spt->tree);
+}
+
+/*
+ * Rotates the child up over its parent.
+ */
+static void rotateUp(BST *t, BSTNODE *child) {
+	BSTNODE *parent = getBSTNODEparent(child);
+	if(child == getBSTNODEleft(parent))
+		rotateRightBST(t, parent);
+	else
+		rotateLeftBST(t, parent);
+}
+/*
+ * Moves the node to the root with zig, zig-zig and zig-zag steps. In semi-splay
+ * mode a zig-zig step only rotates the parent up and carries on from there.
+ */
+static void splay(SPT *spt, BSTNODE *node) {
+	BST *t = spt->tree;
+	while(node != getBSTroot(t)) {
+		BSTNODE *parent = getBSTNODEparent(node);
+		if(parent == getBSTroot(t)) {
+			rotateUp(t, node);
+			break;
+		}
+		BSTNODE *grandparent = getBSTNODEparent(parent);
+		int zigzig = (node == getBSTNODEleft(parent)) == (parent == getBSTNODEleft(grandparent));
+		if(zigzig && (spt->flags & SPT_SEMISPLAY)) {
+			rotateUp(t, parent);
+			node = parent;
+		} else if(zigzig) {
+			rotateUp(t, parent);
+			rotateUp(t, node);
+		} else {
+			rotateUp(t, node);
+			rotateUp(t, node);
+		}
+	}
+}
+
+static SPTVALUE keySPTVALUE(SPT *spt, void *value) {
+	SPTVALUE key;
+	key.value = value;
+	key.freq = 0;
+	key.display = spt->display;
+	key.compare = spt->compare;
+	return key;
+}
+static void displaySPTVALUE(FILE *fp, void *value) {
+	SPTVALUE *v = value;
+	v->display(fp, v->value);
+	if(v->freq > 1)
+		fprintf(fp, "-%lld", v->freq);
+}
+static int compareSPTVALUE(void *x, void *y) {
+	SPTVALUE *p = x, *q = y;
+	return p->compare(p->value, q->value);
+}
+static long long weighSPTVALUE(void *value) {
+	SPTVALUE *v = value;
+	return v->freq;
+}
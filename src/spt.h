@@ -0,0 +1,23 @@
+#ifndef __SPT_INCLUDED__
+#define __SPT_INCLUDED__
+
+#include <stdio.h>
+
+#define SPT_SEMISPLAY 1
+#define SPT_FIND_ONLY 2
+
+typedef struct spt SPT;
+
+extern SPT *newSPT(
+	void (*)(FILE *,void *),           //display
+	int (*)(void *,void *),            //comparator
+	int flags);                        //SPT_SEMISPLAY, SPT_FIND_ONLY or 0
+extern void insertSPT(SPT *,void *);
+extern long long findSPT(SPT *,void *);
+extern int deleteSPT(SPT *,void *);
+extern int sizeSPT(SPT *);
+extern long long wordsSPT(SPT *);
+extern void statisticsSPT(FILE *,SPT *);
+extern void displaySPT(FILE *,SPT *);
+
+#endif
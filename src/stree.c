@@ -0,0 +1,23 @@
+#include "stree.h"
+#include <string.h>
+
+/*
+ * Contains the string keyed trees generated from ktree.h. Keys are compared
+ * with an inlined memcmp on their bytes, the shorter key coming first on a tie.
+ */
+
+STRKEY newSTRKEY(const char *bytes, int len) {
+	STRKEY key;
+	key.len = len;
+	key.bytes = bytes;
+	return key;
+}
+static inline int compareSTRKEY(STRKEY a, STRKEY b) {
+	int comparison = memcmp(a.bytes, b.bytes, a.len < b.len ? a.len : b.len);
+	if(comparison != 0)
+		return comparison;
+	return (a.len > b.len) - (a.len < b.len);
+}
+
+DEFINE_KTREE(SRBT, STRKEY, compareSTRKEY, 1)
+DEFINE_KTREE(SGT, STRKEY, compareSTRKEY, 0)
@@ -0,0 +1,26 @@
+#ifndef __STREE_INCLUDED__
+#define __STREE_INCLUDED__
+
+#include <stdio.h>
+#include "ktree.h"
+
+/*
+ * A length-prefixed string key. The key itself (length and pointer) is stored
+ * inside the tree node, while the bytes stay owned by the caller and must
+ * outlive the tree.
+ */
+typedef struct strkey {
+	int len;
+	const char *bytes;
+} STRKEY;
+
+extern STRKEY newSTRKEY(const char *bytes,int len);
+
+/*
+ * Frequency counting trees keyed by STRKEYs. SRBT is the red-black version and
+ * SGT the unbalanced green tree version.
+ */
+DECLARE_KTREE(SRBT, STRKEY)
+DECLARE_KTREE(SGT, STRKEY)
+
+#endif
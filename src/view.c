@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+#include "view.h"
+#include "ht.h"
+#include <assert.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Contains the implementation for string keys that point straight into a file
+ * mapped read-only into memory, so counting the words of a file does not copy
+ * any of its bytes. A VIEW is a pointer and a length into a MAPPING, and comes
+ * with comparator, display, hash, equality and key callbacks for the RBT, GT,
+ * HT and ART.
+ *
+ * A MAPPING is reference counted and stays mapped until its last reference is
+ * released. The caller holds one reference from newMAPPING and every VIEW made
+ * by newVIEW or internVIEW holds another, so a tree of views keeps its file
+ * mapped after the caller lets go of the mapping. The views must be freed, or
+ * their INTERN freed, after the trees using them.
+ *
+ * An INTERN keeps one VIEW per distinct key, allocated in blocks, so a key that
+ * occurs a million times costs one VIEW.
+ */
+
+#define BLOCK 4096              //views per INTERN allocation
+
+#ifdef __GNUC__
+#define RETAIN(m) __atomic_add_fetch(&(m)->refs, 1, __ATOMIC_RELAXED)
+#define DROP(m) __atomic_sub_fetch(&(m)->refs, 1, __ATOMIC_ACQ_REL)
+#else
+#define RETAIN(m) (++(m)->refs)
+#define DROP(m) (--(m)->refs)
+#endif
+
+struct mapping {
+	const unsigned char *bytes;
+	long long size;
+	int refs;
+};
+
+typedef struct viewblock {
+	struct viewblock *next;
+	int used;
+	VIEW views[BLOCK];
+} VIEWBLOCK;
+
+struct intern {
+	HT *table;
+	VIEWBLOCK *blocks;
+	long long lookups;
+};
+
+/*
+ * Maps the file read-only. Returns NULL if it cannot be opened or mapped. The
+ * caller holds the one reference to the new mapping.
+ */
+MAPPING *newMAPPING(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	MAPPING *m = malloc(sizeof(MAPPING));
+	assert(m != 0);
+	m->size = st.st_size;
+	m->refs = 1;
+	m->bytes = NULL;
+	if(m->size > 0) {
+		void *p = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p == MAP_FAILED) {
+			close(fd);
+			free(m);
+			return NULL;
+		}
+		m->bytes = p;
+	}
+	//The mapping outlives the descriptor
+	close(fd);
+	return m;
+}
+MAPPING *retainMAPPING(MAPPING *m) {
+	RETAIN(m);
+	return m;
+}
+/*
+ * Drops a reference, unmapping the file when it was the last one.
+ */
+void releaseMAPPING(MAPPING *m) {
+	if(DROP(m) > 0)
+		return;
+	if(m->bytes != NULL)
+		munmap((void *) m->bytes, m->size);
+	free(m);
+}
+const unsigned char *bytesMAPPING(MAPPING *m) {
+	return m->bytes;
+}
+long long sizeMAPPING(MAPPING *m) {
+	return m->size;
+}
+/*
+ * Visits a VIEW of each token of the mapping in turn. A token is a run of
+ * letters, digits and bytes above 127, as in the INGEST pipeline, but since the
+ * bytes cannot be changed it is not folded to lower case. The VIEW lives on the
+ * stack and holds no reference, so it must be passed to internVIEW, or copied
+ * with newVIEW, to be kept.
+ */
+void tokensMAPPING(MAPPING *m, void (*visit)(VIEW *, void *), void *arg) {
+	long long i = 0;
+	while(i < m->size) {
+		while(i < m->size && !(isalnum(m->bytes[i]) || m->bytes[i] > 127))
+			i++;
+		long long start = i;
+		while(i < m->size && (isalnum(m->bytes[i]) || m->bytes[i] > 127))
+			i++;
+		if(i > start) {
+			VIEW token;
+			token.bytes = m->bytes + start;
+			token.length = i - start;
+			token.source = m;
+			visit(&token, arg);
+		}
+	}
+}
+
+/*
+ * Creates a view of length bytes of the mapping, holding a reference to it.
+ */
+VIEW *newVIEW(MAPPING *m, long long offset, int length) {
+	assert(offset >= 0 && length >= 0 && offset + length <= m->size);
+	VIEW *v = malloc(sizeof(VIEW));
+	assert(v != 0);
+	v->bytes = m->bytes + offset;
+	v->length = length;
+	v->source = retainMAPPING(m);
+	return v;
+}
+/*
+ * Frees a view made by newVIEW. Views made by internVIEW belong to their INTERN.
+ */
+void freeVIEW(VIEW *v) {
+	if(v->source != NULL)
+		releaseMAPPING(v->source);
+	free(v);
+}
+/*
+ * Orders views by their bytes, a view that is a prefix of another coming first.
+ * This is the order the ART walks in.
+ */
+int compareVIEW(void *a, void *b) {
+	VIEW *x = a, *y = b;
+	int shorter = x->length < y->length ? x->length : y->length;
+	//Words are short, so a byte loop beats the call to memcmp
+	for(int i=0; i<shorter; i++)
+		if(x->bytes[i] != y->bytes[i])
+			return x->bytes[i] - y->bytes[i];
+	return (x->length > y->length) - (x->length < y->length);
+}
+int equalsVIEW(void *a, void *b) {
+	VIEW *x = a, *y = b;
+	return x->length == y->length && memcmp(x->bytes, y->bytes, x->length) == 0;
+}
+unsigned hashVIEW(void *a) {
+	VIEW *v = a;
+	unsigned h = 2166136261u;
+	for(int i=0; i<v->length; i++)
+		h = (h ^ v->bytes[i]) * 16777619u;
+	return h;
+}
+const unsigned char *keyVIEW(void *a, int *length) {
+	VIEW *v = a;
+	*length = v->length;
+	return v->bytes;
+}
+/*
+ * Returns the first 8 bytes of the view as a big-endian integer, for
+ * setRBTprefix/setGTprefix. Most comparisons are then settled inside the tree
+ * nodes without touching the mapped bytes, which are scattered over the file.
+ */
+unsigned long long prefixVIEW(void *a) {
+	VIEW *v = a;
+	unsigned long long prefix = 0;
+	for(int i=0; i<8; i++)
+		prefix = prefix << 8 | (i < v->length ? v->bytes[i] : 0);
+	return prefix;
+}
+void displayVIEW(FILE *fp, void *a) {
+	VIEW *v = a;
+	fwrite(v->bytes, 1, v->length, fp);
+}
+
+INTERN *newINTERN(void) {
+	INTERN *p = malloc(sizeof(INTERN));
+	assert(p != 0);
+	p->table = newHT(displayVIEW, hashVIEW, equalsVIEW);
+	p->blocks = NULL;
+	p->lookups = 0;
+	return p;
+}
+/*
+ * Returns the pool's view with the same bytes as the given one, adding a copy of
+ * the given view, with a reference to its mapping, if there is none yet. The
+ * given view may live on the stack.
+ */
+VIEW *internVIEW(INTERN *p, VIEW *key) {
+	p->lookups++;
+	VIEW *v = getHT(p->table, key);
+	if(v != NULL)
+		return v;
+	if(p->blocks == NULL || p->blocks->used == BLOCK) {
+		VIEWBLOCK *block = malloc(sizeof(VIEWBLOCK));
+		assert(block != 0);
+		block->next = p->blocks;
+		block->used = 0;
+		p->blocks = block;
+	}
+	v = &p->blocks->views[p->blocks->used++];
+	*v = *key;
+	if(v->source != NULL)
+		retainMAPPING(v->source);
+	insertHT(p->table, v);
+	return v;
+}
+int sizeINTERN(INTERN *p) {
+	return sizeHT(p->table);
+}
+void statisticsINTERN(FILE *fp, INTERN *p) {
+	int blocks = 0;
+	for(VIEWBLOCK *b = p->blocks; b != NULL; b = b->next)
+		blocks++;
+	fprintf(fp, "Interned views: %d\n", sizeHT(p->table));
+	fprintf(fp, "Lookups: %lld\n", p->lookups);
+	fprintf(fp, "View blocks: %d(%lld bytes)\n", blocks, (long long) blocks * sizeof(VIEWBLOCK));
+}
+/*
+ * Frees the pool and its views, releasing their mappings. Any tree holding the
+ * views must not be used afterwards.
+ */
+void freeINTERN(INTERN *p) {
+	VIEWBLOCK *b = p->blocks;
+	while(b != NULL) {
+		VIEWBLOCK *next = b->next;
+		for(int i=0; i<b->used; i++)
+			if(b->views[i].source != NULL)
+				releaseMAPPING(b->views[i].source);
+		free(b);
+		b = next;
+	}
+	freeHT(p->table);
+	free(p);
+}
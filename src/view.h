@@ -0,0 +1,44 @@
+#ifndef __VIEW_INCLUDED__
+#define __VIEW_INCLUDED__
+
+#include <stdio.h>
+
+typedef struct mapping MAPPING;
+typedef struct intern INTERN;
+
+/*
+ * A key that points into a MAPPING instead of owning a copy of its bytes. The
+ * struct is public so that lookups can build one on the stack; source may then
+ * be NULL.
+ */
+typedef struct view {
+	const unsigned char *bytes;
+	int length;
+	MAPPING *source;
+} VIEW;
+
+extern MAPPING *newMAPPING(const char *path);
+extern MAPPING *retainMAPPING(MAPPING *);
+extern void releaseMAPPING(MAPPING *);
+extern const unsigned char *bytesMAPPING(MAPPING *);
+extern long long sizeMAPPING(MAPPING *);
+extern void tokensMAPPING(MAPPING *,
+	void (*)(VIEW *,void *),           //visit(token,arg)
+	void *arg);
+
+extern VIEW *newVIEW(MAPPING *,long long offset,int length);
+extern void freeVIEW(VIEW *);
+extern int  compareVIEW(void *,void *);
+extern int  equalsVIEW(void *,void *);
+extern unsigned hashVIEW(void *);
+extern const unsigned char *keyVIEW(void *,int *);
+extern unsigned long long prefixVIEW(void *);
+extern void displayVIEW(FILE *,void *);
+
+extern INTERN *newINTERN(void);
+extern VIEW *internVIEW(INTERN *,VIEW *);
+extern int  sizeINTERN(INTERN *);
+extern void statisticsINTERN(FILE *,INTERN *);
+extern void freeINTERN(INTERN *);
+
+#endif